@@ -7,8 +7,93 @@
 #include "v1/v1_compiler.h"
 #include "v2/v2_compiler.h"
 
+#ifndef N64_WIN
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 n64_dynarec_t n64dynarec;
 
+#ifndef N64_WIN
+static struct sigaction prev_sigsegv_action;
+// Only writes from the thread running the CPU are expected to fault, see n64_dynarec_enable_smc_mprotect()
+static pthread_t smc_thread;
+
+INLINE void set_rdram_page_protection(u32 page, bool protect) {
+    u8* host_page = &n64sys.mem.rdram[page << BLOCKCACHE_OUTER_SHIFT];
+    if (mprotect(host_page, BLOCKCACHE_PAGE_SIZE, protect ? PROT_READ : PROT_READ | PROT_WRITE) != 0) {
+        logfatal("mprotect RDRAM page 0x%05X failed!", page);
+    }
+    n64dynarec.rdram_page_protected[page] = protect;
+}
+
+// Only async signal safe calls in here, so no logging.
+static void smc_sigsegv_handler(int signum, siginfo_t* info, void* context) {
+    uintptr_t fault_address = (uintptr_t)info->si_addr;
+    uintptr_t rdram_base = (uintptr_t)n64sys.mem.rdram;
+
+    if (fault_address >= rdram_base && fault_address < rdram_base + N64_RDRAM_SIZE && pthread_equal(pthread_self(), smc_thread)) {
+        u32 page = (fault_address - rdram_base) >> BLOCKCACHE_OUTER_SHIFT;
+        u8* host_page = &n64sys.mem.rdram[page << BLOCKCACHE_OUTER_SHIFT];
+        if (n64dynarec.rdram_page_protected[page] && mprotect(host_page, BLOCKCACHE_PAGE_SIZE, PROT_READ | PROT_WRITE) == 0) {
+            n64dynarec.rdram_page_protected[page] = false;
+            // RDRAM starts at physical address 0, so the host page is also the blockcache page.
+            invalidate_dynarec_page_by_index(page);
+            return; // Returning retries the faulting write, which will now succeed.
+        }
+    }
+
+    // Not ours. Put back whatever was there before and return, the access faults again and gets the old action,
+    // which is the default one (a core dump pointing at the access) unless someone else had a handler.
+    sigaction(SIGSEGV, &prev_sigsegv_action, NULL);
+}
+#endif
+
+bool n64_dynarec_enable_smc_mprotect() {
+#ifdef N64_WIN
+    logwarn("Page protection based SMC detection is not supported on Windows, falling back to checking every write.");
+    return false;
+#else
+    if (sysconf(_SC_PAGESIZE) != BLOCKCACHE_PAGE_SIZE) {
+        logwarn("Host page size (%ld) doesn't match the dynarec page size (%d), falling back to checking every write.", sysconf(_SC_PAGESIZE), BLOCKCACHE_PAGE_SIZE);
+        return false;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = smc_sigsegv_handler;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &prev_sigsegv_action) != 0) {
+        logwarn("Failed to install SIGSEGV handler, falling back to checking every write.");
+        return false;
+    }
+
+    // Anything else writing to RDRAM (the RSP thread, the software RDP's threads) isn't allowed alongside this, the
+    // frontend turns it down. Their writes would invalidate blocks under the CPU's feet.
+    smc_thread = pthread_self();
+    n64dynarec.smc_mprotect = true;
+    return true;
+#endif
+}
+
+// Write protect the RDRAM pages a newly compiled block was read from
+INLINE void protect_code_pages(u32 physical_address, size_t guest_size) {
+#ifndef N64_WIN
+    if (physical_address > EREGION_RDRAM) {
+        return;
+    }
+    u32 last_address = MIN(physical_address + MAX(guest_size, 4) - 1, EREGION_RDRAM);
+    for (u32 page = BLOCKCACHE_OUTER_INDEX(physical_address); page <= BLOCKCACHE_OUTER_INDEX(last_address); page++) {
+        if (!n64dynarec.rdram_page_protected[page]) {
+            set_rdram_page_protection(page, true);
+        }
+    }
+#endif
+}
+
 void update_sysconfig() {
     // handled by cp0_status_updated
     //n64dynarec.sysconfig.fr = N64CP0.status.fr;
@@ -37,6 +122,10 @@ int missing_block_handler(u32 physical_address, n64_dynarec_block_t* block, n64_
         //v1_compile_new_block(block, code_mask, N64CPU.pc, physical);
     }
 
+    if (n64dynarec.smc_mprotect) {
+        protect_code_pages(physical_address, block->guest_size);
+    }
+
     return n64dynarec.run_block((u64)block->run);
 }
 
@@ -66,6 +155,9 @@ INLINE n64_dynarec_block_t* find_matching_block(n64_dynarec_block_t* blocks, n64
 }
 
 int n64_dynarec_step() {
+    n64_block_link_t* link = n64dynarec.pending_link;
+    n64dynarec.pending_link = NULL;
+
     N64CPU.branch = false;
     N64CPU.prev_branch = false;
     u32 physical;
@@ -110,6 +202,14 @@ int n64_dynarec_step() {
     {
         n64_dynarec_block_t* matching_block = find_matching_block(block, n64dynarec.sysconfig, N64CPU.pc);
         if (matching_block && matching_block->run) {
+#ifndef N64_LOG_JIT_SYNC_POINTS
+            // Only link to unmapped addresses, so TLB writes and ASID changes don't need to break links.
+            if (link != NULL && n64dynarec.link_blocks && !is_tlb(N64CPU.pc)) {
+                link->virtual_address = N64CPU.pc;
+                link->run = matching_block->run;
+                link->generation = n64dynarec.link_generation;
+            }
+#endif
             taken = n64dynarec.run_block((u64)matching_block->run);
         } else {
             return missing_block_handler(physical, matching_block, n64dynarec.sysconfig);
@@ -144,6 +244,8 @@ void n64_dynarec_init(u8* codecache, size_t codecache_size) {
     }
 
     n64dynarec.codecache = codecache;
+    // Links start out zeroed, so generation 0 must never be valid.
+    n64dynarec.link_generation = 1;
 
     v1_compiler_init();
     v2_compiler_init();
@@ -153,4 +255,14 @@ void invalidate_dynarec_all_pages() {
     for (int i = 0; i < BLOCKCACHE_OUTER_SIZE; i++) {
         n64dynarec.blockcache[i] = NULL;
     }
+    unlink_dynarec_blocks();
+#ifndef N64_WIN
+    if (n64dynarec.smc_mprotect) {
+        for (int i = 0; i < N64_RDRAM_SIZE >> BLOCKCACHE_OUTER_SHIFT; i++) {
+            if (n64dynarec.rdram_page_protected[i]) {
+                set_rdram_page_protection(i, false);
+            }
+        }
+    }
+#endif
 }
\ No newline at end of file
@@ -54,6 +54,15 @@ typedef struct n64_dynarec_block {
     struct n64_dynarec_block* next; // for other sysconfigs
 } n64_dynarec_block_t;
 
+// Follows each block exit, in the code cache. When the guest PC at the exit matches and nothing was invalidated since
+// the link was made, the exit jumps straight into the next block instead of returning to n64_dynarec_step().
+typedef struct n64_block_link {
+    u64 virtual_address;
+    int (*run)(r4300i_t* cpu);
+    u32 generation;
+    u32 padding;
+} n64_block_link_t;
+
 INLINE void copy_dynarec_block(n64_dynarec_block_t* dest, n64_dynarec_block_t* src) {
     dest->run = src->run;
     dest->guest_size = src->guest_size;
@@ -72,12 +81,29 @@ typedef struct n64_dynarec {
 
     n64_dynarec_block_t* blockcache[BLOCKCACHE_OUTER_SIZE];
     bool* code_mask[BLOCKCACHE_OUTER_SIZE];
+
+    // When enabled, RDRAM pages containing compiled code are write protected, and writes to them are caught by a
+    // SIGSEGV handler instead of being checked against code_mask on every store.
+    bool smc_mprotect;
+    bool rdram_page_protected[N64_RDRAM_SIZE >> BLOCKCACHE_OUTER_SHIFT];
+
+    // When enabled, blocks chain into each other until the next scheduler event is due.
+    bool link_blocks;
+    // Bumped whenever compiled code or address translation changes, which breaks every existing link.
+    u32 link_generation;
+    // Set by a block that exited through a link that wasn't valid, filled in once the next block is found.
+    n64_block_link_t* pending_link;
 } n64_dynarec_t;
 
 extern n64_dynarec_t n64dynarec;
 
+INLINE void unlink_dynarec_blocks() {
+    n64dynarec.link_generation++;
+}
+
 INLINE void invalidate_dynarec_page_by_index(u32 outer_index) {
     n64dynarec.blockcache[outer_index] = NULL;
+    unlink_dynarec_blocks();
 }
 
 INLINE bool is_code(u32 physical_address) {
@@ -91,8 +117,33 @@ INLINE void invalidate_dynarec_page(u32 physical_address) {
     }
 }
 
+// For writes of more than one word, which can miss code that doesn't start at the first one. The range has to stay
+// within one page. Returns whether the page was invalidated.
+INLINE bool invalidate_dynarec_page_range(u32 physical_address, u32 length) {
+    bool* code_mask = n64dynarec.code_mask[BLOCKCACHE_OUTER_INDEX(physical_address)];
+    if (likely(code_mask == NULL)) {
+        return false;
+    }
+    u32 last = BLOCKCACHE_INNER_INDEX(physical_address + length - 1);
+    for (u32 i = BLOCKCACHE_INNER_INDEX(physical_address); i <= last; i++) {
+        if (code_mask[i]) {
+            invalidate_dynarec_page_by_index(BLOCKCACHE_OUTER_INDEX(physical_address));
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes to RDRAM only need checking when page protection isn't catching them already.
+INLINE void invalidate_dynarec_ram(u32 physical_address) {
+    if (!n64dynarec.smc_mprotect) {
+        invalidate_dynarec_page(physical_address);
+    }
+}
+
 int n64_dynarec_step();
 void n64_dynarec_init(u8* codecache, size_t codecache_size);
+bool n64_dynarec_enable_smc_mprotect();
 void invalidate_dynarec_page(u32 physical_address);
 void invalidate_dynarec_all_pages();
 
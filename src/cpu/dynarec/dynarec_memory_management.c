@@ -10,15 +10,24 @@ void flush_code_cache() {
     for (int i = 0; i < BLOCKCACHE_OUTER_SIZE; i++) {
         n64dynarec.blockcache[i] = NULL;
     }
+    unlink_dynarec_blocks();
+    n64dynarec.pending_link = NULL;
 }
 
 void flush_rsp_code_cache() {
     // Just set the pointer back to the beginning, no need to clear the actual data.
     N64RSPDYNAREC->codecache_used = 0;
 
-    // However, the block cache needs to be fully invalidated.
-    for (int i = 0; i < RSP_BLOCKCACHE_SIZE; i++) {
-        N64RSPDYNAREC->blockcache[i].run = rsp_missing_block_handler;
+    // However, the block caches need to be fully invalidated. The current microcode's entry stays valid, since IMEM
+    // still matches it, but every other one has to be compiled again from scratch.
+    for (int i = 0; i < RSP_UCODE_CACHE_SIZE; i++) {
+        rsp_ucode_cache_entry_t* entry = &N64RSPDYNAREC->ucode_cache[i];
+        for (int j = 0; j < RSP_BLOCKCACHE_SIZE; j++) {
+            entry->blockcache[j].run = rsp_missing_block_handler;
+        }
+        if (entry != N64RSPDYNAREC->current_ucode) {
+            entry->valid = false;
+        }
     }
 }
 
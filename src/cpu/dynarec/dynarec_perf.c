@@ -0,0 +1,169 @@
+#include "dynarec_perf.h"
+
+#include <log.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+bool dynarec_perf_enabled = false;
+
+#ifdef __linux__
+static FILE* perf_map_file = NULL;
+static FILE* jitdump_file = NULL;
+static void* jitdump_marker = NULL;
+static u64 jitdump_code_index = 0;
+
+#define JITDUMP_MAGIC 0x4A695444
+#define JITDUMP_VERSION 1
+
+typedef enum jitdump_record_type {
+    JIT_CODE_LOAD = 0,
+    JIT_CODE_CLOSE = 3
+} jitdump_record_type_t;
+
+typedef struct jitdump_header {
+    u32 magic;
+    u32 version;
+    u32 total_size;
+    u32 elf_mach;
+    u32 pad1;
+    u32 pid;
+    u64 timestamp;
+    u64 flags;
+} jitdump_header_t;
+
+typedef struct jitdump_record_header {
+    u32 id;
+    u32 total_size;
+    u64 timestamp;
+} jitdump_record_header_t;
+
+typedef struct jitdump_code_load {
+    jitdump_record_header_t header;
+    u32 pid;
+    u32 tid;
+    u64 vma;
+    u64 code_addr;
+    u64 code_size;
+    u64 code_index;
+    // Followed by the null terminated name and the code itself
+} jitdump_code_load_t;
+
+// Must match the clock perf uses with -k mono
+INLINE u64 jitdump_timestamp() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void jitdump_open() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/jit-%d.dump", getpid());
+    jitdump_file = fopen(path, "w+");
+    if (jitdump_file == NULL) {
+        logwarn("Unable to open %s, jitdump disabled", path);
+        return;
+    }
+
+    jitdump_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.total_size = sizeof(header);
+    header.elf_mach = EM_X86_64;
+    header.pid = getpid();
+    header.timestamp = jitdump_timestamp();
+    fwrite(&header, sizeof(header), 1, jitdump_file);
+    fflush(jitdump_file);
+
+    // perf finds the dump through this mapping showing up in its mmap events.
+    jitdump_marker = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(jitdump_file), 0);
+    if (jitdump_marker == MAP_FAILED) {
+        logwarn("Unable to mmap %s, jitdump disabled", path);
+        fclose(jitdump_file);
+        jitdump_file = NULL;
+        jitdump_marker = NULL;
+    }
+}
+#endif
+
+void dynarec_perf_init(bool perf_map, bool jitdump) {
+#ifdef __linux__
+    if (perf_map && perf_map_file == NULL) {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+        perf_map_file = fopen(path, "w");
+        if (perf_map_file == NULL) {
+            logwarn("Unable to open %s, perf map disabled", path);
+        }
+    }
+
+    if (jitdump && jitdump_file == NULL) {
+        jitdump_open();
+    }
+
+    dynarec_perf_enabled = perf_map_file != NULL || jitdump_file != NULL;
+#else
+    if (perf_map || jitdump) {
+        logwarn("perf map and jitdump output are only supported on Linux");
+    }
+#endif
+}
+
+void dynarec_perf_register_block(const char* name, const void* code, size_t code_size) {
+#ifdef __linux__
+    if (perf_map_file) {
+        fprintf(perf_map_file, "%" PRIxPTR " %zx %s\n", (uintptr_t)code, code_size, name);
+        fflush(perf_map_file);
+    }
+
+    if (jitdump_file) {
+        size_t name_size = strlen(name) + 1;
+        jitdump_code_load_t record;
+        record.header.id = JIT_CODE_LOAD;
+        record.header.total_size = sizeof(record) + name_size + code_size;
+        record.header.timestamp = jitdump_timestamp();
+        record.pid = getpid();
+        record.tid = syscall(SYS_gettid);
+        record.vma = (uintptr_t)code;
+        record.code_addr = (uintptr_t)code;
+        record.code_size = code_size;
+        record.code_index = jitdump_code_index++;
+
+        fwrite(&record, sizeof(record), 1, jitdump_file);
+        fwrite(name, name_size, 1, jitdump_file);
+        fwrite(code, code_size, 1, jitdump_file);
+    }
+#endif
+}
+
+void dynarec_perf_close() {
+#ifdef __linux__
+    if (perf_map_file) {
+        fclose(perf_map_file);
+        perf_map_file = NULL;
+    }
+
+    if (jitdump_file) {
+        jitdump_record_header_t close;
+        close.id = JIT_CODE_CLOSE;
+        close.total_size = sizeof(close);
+        close.timestamp = jitdump_timestamp();
+        fwrite(&close, sizeof(close), 1, jitdump_file);
+
+        munmap(jitdump_marker, sysconf(_SC_PAGESIZE));
+        fclose(jitdump_file);
+        jitdump_file = NULL;
+        jitdump_marker = NULL;
+    }
+
+    dynarec_perf_enabled = false;
+#endif
+}
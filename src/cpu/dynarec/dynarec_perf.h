@@ -0,0 +1,17 @@
+#ifndef N64_DYNAREC_PERF_H
+#define N64_DYNAREC_PERF_H
+
+#include <util.h>
+
+// Lets Linux perf attribute samples in the code caches to guest blocks.
+// perf map: /tmp/perf-<pid>.map, picked up automatically by perf report.
+// jitdump: /tmp/jit-<pid>.dump, use with perf record -k mono and perf inject --jit. Includes the host code, so perf
+// annotate can disassemble blocks.
+
+extern bool dynarec_perf_enabled;
+
+void dynarec_perf_init(bool perf_map, bool jitdump);
+void dynarec_perf_register_block(const char* name, const void* code, size_t code_size);
+void dynarec_perf_close();
+
+#endif //N64_DYNAREC_PERF_H
@@ -1,8 +1,10 @@
 #include <log.h>
+#include <string.h>
 #include <rsp.h>
 #include "rsp_dynarec.h"
 #include "v1/v1_emitter.h"
 #include "dynarec_memory_management.h"
+#include "dynarec_perf.h"
 
 size_t rsp_link(dasm_State** d) {
     size_t code_size;
@@ -10,8 +12,9 @@ size_t rsp_link(dasm_State** d) {
     return code_size;
 }
 
-void* rsp_link_and_encode(dasm_State** Dst) {
+void* rsp_link_and_encode(dasm_State** Dst, size_t* code_size_out) {
     size_t code_size = rsp_link(Dst);
+    *code_size_out = code_size;
 #ifdef N64_LOG_COMPILATIONS
     printf("Generated %ld bytes of RSP code\n", code_size);
 #endif
@@ -25,6 +28,7 @@ void* rsp_link_and_encode(dasm_State** Dst) {
 
 void compile_new_rsp_block(rsp_dynarec_block_t* block, u16 address) {
     dasm_State** Dst = v1_block_header();
+    u16 start_address = address;
 
     int block_length = 0;
     int block_extra_cycles = 0;
@@ -100,10 +104,17 @@ void compile_new_rsp_block(rsp_dynarec_block_t* block, u16 address) {
     }
 
     end_rsp_block(Dst, block_length + block_extra_cycles);
-    void* compiled = rsp_link_and_encode(Dst);
+    size_t code_size;
+    void* compiled = rsp_link_and_encode(Dst, &code_size);
     v1_dasm_free();
 
     block->run = compiled;
+
+    if (unlikely(dynarec_perf_enabled)) {
+        char name[32];
+        snprintf(name, sizeof(name), "rsp_block_%03X", start_address);
+        dynarec_perf_register_block(name, compiled, code_size);
+    }
 }
 
 int rsp_missing_block_handler() {
@@ -113,21 +124,78 @@ int rsp_missing_block_handler() {
     return block->run(&N64RSP);
 }
 
+static void reset_ucode_cache_entry(rsp_ucode_cache_entry_t* entry) {
+    for (int i = 0; i < RSP_BLOCKCACHE_SIZE; i++) {
+        entry->blockcache[i].run = rsp_missing_block_handler;
+    }
+}
+
 rsp_dynarec_t* rsp_dynarec_init(u8* codecache, size_t codecache_size) {
     rsp_dynarec_t* dynarec = calloc(1, sizeof(rsp_dynarec_t));
 
     dynarec->codecache_size = codecache_size;
     dynarec->codecache_used = 0;
 
-    for (int i = 0; i < RSP_BLOCKCACHE_SIZE; i++) {
-        dynarec->blockcache[i].run = rsp_missing_block_handler;
+    for (int i = 0; i < RSP_UCODE_CACHE_SIZE; i++) {
+        reset_ucode_cache_entry(&dynarec->ucode_cache[i]);
     }
+    dynarec->current_ucode = &dynarec->ucode_cache[0];
+    dynarec->blockcache = dynarec->current_ucode->blockcache;
+    dynarec->imem_dirty = true;
 
     dynarec->codecache = codecache;
 
     return dynarec;
 }
 
+// FNV-1a over the whole of IMEM
+static u64 hash_imem() {
+    u64 hash = 0xCBF29CE484222325;
+    for (int i = 0; i < SP_IMEM_SIZE; i += sizeof(u64)) {
+        u64 word;
+        memcpy(&word, &N64RSP.sp_imem[i], sizeof(u64));
+        hash ^= word;
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+// Switches to the blocks compiled for the current IMEM contents, evicting the least recently used entry if they've
+// never been seen before.
+void rsp_dynarec_select_ucode() {
+    rsp_dynarec_t* dynarec = N64RSPDYNAREC;
+    dynarec->imem_dirty = false;
+    u64 hash = hash_imem();
+
+    rsp_ucode_cache_entry_t* match = NULL;
+    rsp_ucode_cache_entry_t* victim = &dynarec->ucode_cache[0];
+    for (int i = 0; i < RSP_UCODE_CACHE_SIZE; i++) {
+        rsp_ucode_cache_entry_t* entry = &dynarec->ucode_cache[i];
+        if (entry->valid && entry->hash == hash && memcmp(entry->imem, N64RSP.sp_imem, SP_IMEM_SIZE) == 0) {
+            match = entry;
+            break;
+        }
+        if (!entry->valid || (victim->valid && entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+
+    if (match == NULL) {
+        match = victim;
+        reset_ucode_cache_entry(match);
+        match->valid = true;
+        match->hash = hash;
+        memcpy(match->imem, N64RSP.sp_imem, SP_IMEM_SIZE);
+    }
+
+    match->last_used = ++dynarec->ucode_switches;
+    dynarec->current_ucode = match;
+    dynarec->blockcache = match->blockcache;
+}
+
 int rsp_dynarec_step() {
+    if (unlikely(N64RSPDYNAREC->imem_dirty)) {
+        rsp_dynarec_select_ucode();
+    }
     return N64RSPDYNAREC->blockcache[N64RSP.pc & 0x3FF].run(&N64RSP);
 }
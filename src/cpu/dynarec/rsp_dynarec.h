@@ -14,15 +14,35 @@ typedef struct rsp_dynarec_block {
     int (*run)(rsp_t* cpu);
 } rsp_dynarec_block_t;
 
+// Compiled blocks are kept for this many different IMEM contents, so games switching between e.g. the audio and graphics
+// microcodes every frame don't recompile everything each time.
+#define RSP_UCODE_CACHE_SIZE 8
+
+typedef struct rsp_ucode_cache_entry {
+    bool valid;
+    u64 hash;
+    u64 last_used;
+    // IMEM contents the blocks below were compiled from, compared on a hash match.
+    u8 imem[SP_IMEM_SIZE];
+    rsp_dynarec_block_t blockcache[RSP_BLOCKCACHE_SIZE];
+} rsp_ucode_cache_entry_t;
+
 typedef struct rsp_dynarec {
     u8* codecache;
     u64 codecache_size;
     u64 codecache_used;
 
-    rsp_dynarec_block_t blockcache[RSP_BLOCKCACHE_SIZE];
+    // Blocks for the current IMEM contents, points into ucode_cache.
+    rsp_dynarec_block_t* blockcache;
+    // Set whenever IMEM is written. The matching ucode_cache entry is looked up before the next block runs.
+    bool imem_dirty;
+    u64 ucode_switches;
+    rsp_ucode_cache_entry_t* current_ucode;
+    rsp_ucode_cache_entry_t ucode_cache[RSP_UCODE_CACHE_SIZE];
 } rsp_dynarec_t;
 
 rsp_dynarec_t* rsp_dynarec_init(u8* codecache, size_t codecache_size);
+void rsp_dynarec_select_ucode();
 int rsp_dynarec_step();
 int rsp_missing_block_handler();
 
@@ -811,6 +811,28 @@ ir_instruction_t* ir_emit_conditional_block_exit_address(int index, ir_instructi
     return ir_emit_conditional_block_exit_internal(index, condition, COND_BLOCK_EXIT_TYPE_ADDRESS, info);
 }
 
+ir_instruction_t* ir_insert_conditional_block_exit_address(ir_instruction_t* after, ir_instruction_t* condition, ir_instruction_t* address, const ir_flush_info_t* flush_info, int block_length) {
+    ir_instruction_t instruction;
+    instruction.type = IR_COND_BLOCK_EXIT;
+    instruction.cond_block_exit.condition = condition;
+    instruction.cond_block_exit.type = COND_BLOCK_EXIT_TYPE_ADDRESS;
+    instruction.cond_block_exit.info.exit_pc = address;
+
+    ir_instruction_t* allocation = allocate_ir_instruction(instruction);
+    allocation->flush_info = *flush_info;
+    allocation->block_length = block_length;
+
+    allocation->prev = after;
+    allocation->next = after->next;
+    if (after->next) {
+        after->next->prev = allocation;
+    } else {
+        ir_context.ir_cache_tail = allocation;
+    }
+    after->next = allocation;
+    return allocation;
+}
+
 ir_instruction_t* ir_emit_set_block_exit_pc(ir_instruction_t* address) {
     ir_context.block_end_pc_ir_emitted = true;
     ir_instruction_t instruction;
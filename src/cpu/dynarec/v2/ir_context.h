@@ -401,6 +401,8 @@ void ir_instr_to_string(ir_instruction_t* instr, char* buf, size_t buf_size);
 
 // Can this instruction cause an exception? Mostly used internally.
 bool instr_exception_possible(ir_instruction_t* instr);
+// Insert an instruction that can't cause an exception after another one. Mostly used internally.
+ir_instruction_t* insert_ir_instruction(ir_instruction_t* after, ir_instruction_t instruction);
 // Update a guest reg to point at a new value. Mostly used internally.
 void update_guest_reg_mapping(u8 guest_reg, ir_instruction_t* value);
 // Emit a constant to the IR, optionally associating it with a guest register.
@@ -449,6 +451,9 @@ ir_instruction_t* ir_emit_conditional_block_exit_exception(int index, ir_instruc
 ir_instruction_t* ir_emit_exception(int index, dynarec_exception_t exception);
 // exit the block early with an address if the condition is true
 ir_instruction_t* ir_emit_conditional_block_exit_address(int index, ir_instruction_t* condition, ir_instruction_t* address);
+// exit the block early with an address if the condition is true, inserted after an existing instruction. The guest reg
+// mapping isn't known any more once the block has been emitted, so the regs to flush and the block length are given.
+ir_instruction_t* ir_insert_conditional_block_exit_address(ir_instruction_t* after, ir_instruction_t* condition, ir_instruction_t* address, const ir_flush_info_t* flush_info, int block_length);
 // set the block exit pc
 ir_instruction_t* ir_emit_set_block_exit_pc(ir_instruction_t* address);
 // fall back to the interpreter for the next num_instructions instructions
@@ -1,6 +1,7 @@
 #include <log.h>
 #include <string.h>
 #include <mem/n64bus.h>
+#include <mem/mem_util.h>
 #include "ir_optimizer.h"
 #include "target_platform.h"
 
@@ -196,6 +197,93 @@ void ir_optimize_flush_guest_regs() {
     }
 }
 
+// Branches set the exit PC before their delay slot is emitted
+INLINE bool in_delay_slot(ir_instruction_t* instr) {
+    for (ir_instruction_t* prev = instr->prev; prev != NULL; prev = prev->prev) {
+        if (prev->type == IR_SET_BLOCK_EXIT_PC || prev->type == IR_SET_COND_BLOCK_EXIT_PC) {
+            return true;
+        }
+    }
+    return false;
+}
+
+INLINE bool read_rom_constant(u8* rom, u32 offset, ir_value_type_t type, u64* result) {
+    switch (type) {
+        case VALUE_TYPE_S32:
+            if (offset & 0b11) {
+                return false;
+            }
+            *result = (s64)(s32)word_from_byte_array(rom, WORD_ADDRESS(offset));
+            return true;
+        case VALUE_TYPE_U32:
+            if (offset & 0b11) {
+                return false;
+            }
+            *result = word_from_byte_array(rom, WORD_ADDRESS(offset));
+            return true;
+        case VALUE_TYPE_U64:
+        case VALUE_TYPE_S64:
+            if (offset & 0b111) {
+                return false;
+            }
+            *result = dword_from_byte_array(rom, DWORD_ADDRESS(offset));
+            return true;
+        default:
+            // Byte and half loads from the cart have bus quirks of their own, those are left to the PI bus handlers.
+            return false;
+    }
+}
+
+// Cartridge ROM never changes, so a word or dword load from a known address in it can be done at compile time. The
+// exception is a read while a PI write is latched, which returns the latch and stalls the CPU. So the folded load is
+// guarded on io_busy: when it's set, the block exits just before the load, which then starts the next block, and that
+// block's load has a register base, so it goes through the PI bus handlers.
+// Called on the load's TLB lookup right after it has been resolved, it still has the flush info from when the load was
+// emitted, which is what the guard needs.
+INLINE void fold_rom_load(ir_instruction_t* physical) {
+    ir_instruction_t* load = physical->next;
+    if (load == NULL || load->type != IR_LOAD || load->load.address != physical || load->load.reg_type != REGISTER_TYPE_GPR) {
+        return;
+    }
+
+    u32 address = const_to_u64(physical);
+    const n64_bus_page_t* page = n64_bus_get_page(address);
+    if (page->rom == NULL) {
+        return;
+    }
+
+    // The lookup's block length counts the load, exiting before it runs one instruction fewer. Exiting before the
+    // first instruction of the block would just run the block again, and exiting before a delay slot would lose its branch.
+    int block_length = physical->block_length - 1;
+    if (block_length <= 0 || in_delay_slot(physical)) {
+        return;
+    }
+
+    u64 result;
+    if (!read_rom_constant(page->rom, address & N64_BUS_PAGE_MASK, load->load.type, &result)) {
+        return;
+    }
+
+    static_assert(sizeof(n64sys.pi.io_busy) == 1, "io_busy should be one byte");
+    ir_instruction_t io_busy;
+    io_busy.type = IR_GET_PTR;
+    io_busy.get_ptr.type = VALUE_TYPE_U8;
+    io_busy.get_ptr.ptr = (uintptr_t)&n64sys.pi.io_busy;
+    ir_instruction_t* busy = insert_ir_instruction(physical, io_busy);
+
+    ir_instruction_t load_pc;
+    load_pc.type = IR_SET_CONSTANT;
+    load_pc.set_constant.type = VALUE_TYPE_U64;
+    load_pc.set_constant.value_u64 = ir_context.block_start_virtual + (block_length << 2);
+    ir_instruction_t* exit_pc = insert_ir_instruction(busy, load_pc);
+
+    ir_insert_conditional_block_exit_address(exit_pc, busy, exit_pc, &physical->flush_info, block_length);
+
+    load->type = IR_SET_CONSTANT;
+    load->set_constant.type = VALUE_TYPE_U64;
+    load->set_constant.value_u64 = result;
+}
+
 void ir_optimize_constant_propagation() {
     ir_instruction_t* instr = ir_context.ir_cache_head;
     while (instr != NULL) {
@@ -526,6 +614,9 @@ void ir_optimize_constant_propagation() {
                         instr->type = IR_SET_CONSTANT;
                         instr->set_constant.type = VALUE_TYPE_U32;
                         instr->set_constant.value_u32 = resolve_virtual_address_or_die(vaddr, bus_access);
+                        if (bus_access == BUS_LOAD) {
+                            fold_rom_load(instr);
+                        }
                     }
                 }
                 break;
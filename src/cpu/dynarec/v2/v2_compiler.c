@@ -4,11 +4,13 @@
 #include <mem/n64bus.h>
 #include <disassemble.h>
 #include <dynarec/dynarec_memory_management.h>
+#include <dynarec/dynarec_perf.h>
 #include <r4300i.h>
 #include <r4300i_register_access.h>
 #include "v2_emitter.h"
 #include <system/mprotect_utils.h>
 #include <mips_instructions.h>
+#include <guest_profiler.h>
 
 #include "instruction_category.h"
 #include "ir_emitter.h"
@@ -262,6 +264,18 @@ bool is_memory(u64 address) {
     return false; // TODO
 }
 
+// If a word access is to a known register address, the handler for it can be called directly, skipping the bus dispatch.
+const n64_bus_page_t* get_mmio_page(ir_instruction_t* address) {
+    if (instr_valid_immediate(address)) {
+        u32 physical = const_to_u64(address);
+        const n64_bus_page_t* page = n64_bus_get_page(physical);
+        if (page->mmio && (physical & 0b11) == 0) {
+            return page;
+        }
+    }
+    return NULL;
+}
+
 void val_to_func_arg(dasm_State** Dst, ir_instruction_t* val, int arg_index) {
     if (arg_index >= get_num_func_arg_registers()) {
         logfatal("Too many args (%d) passed to fit into registers", arg_index + 1);
@@ -292,11 +306,13 @@ void compile_ir_store(dasm_State** Dst, ir_instruction_t* instr) {
                 host_emit_call(Dst, (uintptr_t)n64_write_physical_half);
                 break;
             case VALUE_TYPE_S32:
-            case VALUE_TYPE_U32:
+            case VALUE_TYPE_U32: {
+                const n64_bus_page_t* page = get_mmio_page(instr->store.address);
                 val_to_func_arg(Dst, instr->store.address, 0);
                 val_to_func_arg(Dst, instr->store.value, 1);
-                host_emit_call(Dst, (uintptr_t)n64_write_physical_word);
+                host_emit_call(Dst, page ? (uintptr_t)page->write_word : (uintptr_t)n64_write_physical_word);
                 break;
+            }
             case VALUE_TYPE_U64:
             case VALUE_TYPE_S64:
                 val_to_func_arg(Dst, instr->store.address, 0);
@@ -323,9 +339,11 @@ void compile_ir_load(dasm_State** Dst, ir_instruction_t* instr) {
                 fp = (uintptr_t)n64_read_physical_half;
                 break;
             case VALUE_TYPE_S32:
-            case VALUE_TYPE_U32:
-                fp = (uintptr_t)n64_read_physical_word;
+            case VALUE_TYPE_U32: {
+                const n64_bus_page_t* page = get_mmio_page(instr->load.address);
+                fp = page ? (uintptr_t)page->read_word : (uintptr_t)n64_read_physical_word;
                 break;
+            }
             case VALUE_TYPE_U64:
             case VALUE_TYPE_S64:
                 fp = (uintptr_t)n64_read_physical_dword;
@@ -1003,6 +1021,12 @@ void v2_emit_block(n64_dynarec_block_t* block, u32 physical_address) {
     if (should_break(physical_address)) {
         host_emit_debugbreak(Dst);
     }
+#ifdef N64_GUEST_PROFILER
+    guest_profile_entry_t* profile_entry = guest_profiler_get_entry(block->virtual_address);
+    profile_entry->physical_address = physical_address;
+    profile_entry->block_length = temp_code_len;
+    host_emit_increment_counter(Dst, (uintptr_t)&profile_entry->jit_count);
+#endif
     ir_instruction_t* instr = ir_context.ir_cache_head;
     while (instr) {
         v2_emit_instr(Dst, instr);
@@ -1023,6 +1047,12 @@ void v2_emit_block(n64_dynarec_block_t* block, u32 physical_address) {
 
     v2_encode(Dst, (u8*)block->run);
     v2_dasm_free();
+
+    if (unlikely(dynarec_perf_enabled)) {
+        char name[64];
+        snprintf(name, sizeof(name), "n64_block_%016" PRIX64 "_%08X", block->virtual_address, physical_address);
+        dynarec_perf_register_block(name, block->run, block->host_size);
+    }
 }
 
 void v2_compile_new_block(
@@ -50,6 +50,7 @@ void host_emit_mov_reg_mem(dasm_State** Dst, ir_register_allocation_t reg_alloc,
 void host_emit_mov_reg_cp0(dasm_State** Dst, ir_register_allocation_t reg_alloc, int cp0_reg);
 void host_emit_mov_cp0_imm(dasm_State** Dst, int cp0_reg, ir_set_constant_t value);
 void host_emit_mov_cp0_reg(dasm_State** Dst, int cp0_reg, ir_register_allocation_t reg_alloc);
+void host_emit_block_exit(dasm_State** Dst, int block_length);
 void host_emit_ret(dasm_State** Dst, ir_flush_info_t* flush_info, int block_length);
 void host_emit_exception_to_args(dasm_State** Dst, dynarec_exception_t exception);
 void host_emit_cond_ret(dasm_State** Dst, ir_register_allocation_t cond_reg_alloc, ir_flush_info_t* flush_info, int block_length, cond_block_exit_type_t type, cond_block_exit_info_t info);
@@ -74,6 +75,7 @@ void host_emit_float_cmp(dasm_State** Dst, ir_float_condition_t condition, ir_fl
 
 void host_emit_debugbreak(dasm_State** Dst);
 void host_emit_call(dasm_State** Dst, uintptr_t function);
+void host_emit_increment_counter(dasm_State** Dst, uintptr_t counter);
 
 void host_emit_eret(dasm_State** Dst);
 
@@ -0,0 +1,135 @@
+#include "guest_profiler.h"
+
+#ifdef N64_GUEST_PROFILER
+#include <log.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <system/n64system.h>
+
+#define PROFILE_BUCKETS (1 << 16)
+#define PROFILE_BUCKET(address) (((address) >> 2) & (PROFILE_BUCKETS - 1))
+
+static guest_profile_entry_t* buckets[PROFILE_BUCKETS];
+static int num_entries = 0;
+
+static const char* report_path = NULL;
+static const char* folded_path = NULL;
+static volatile sig_atomic_t dump_requested = false;
+
+static guest_profile_entry_t* current_interpreter_entry = NULL;
+static u64 next_interpreter_pc = 0;
+
+static void guest_profiler_signal_handler(int signum) {
+    guest_profiler_request_dump();
+}
+
+void guest_profiler_init(const char* report, const char* folded) {
+    report_path = report;
+    folded_path = folded;
+#ifndef N64_WIN
+    signal(SIGQUIT, guest_profiler_signal_handler);
+#endif
+    atexit(guest_profiler_dump);
+}
+
+guest_profile_entry_t* guest_profiler_get_entry(u64 virtual_address) {
+    guest_profile_entry_t** bucket = &buckets[PROFILE_BUCKET(virtual_address)];
+    for (guest_profile_entry_t* entry = *bucket; entry != NULL; entry = entry->next) {
+        if (entry->virtual_address == virtual_address) {
+            return entry;
+        }
+    }
+
+    // Compiled code holds pointers to these, so they're never moved or freed.
+    guest_profile_entry_t* entry = calloc(1, sizeof(guest_profile_entry_t));
+    entry->virtual_address = virtual_address;
+    entry->next = *bucket;
+    *bucket = entry;
+    num_entries++;
+    return entry;
+}
+
+// The interpreter has no blocks, so a new one starts whenever execution doesn't fall through to the next instruction.
+void guest_profiler_interpreter_step(u64 pc) {
+    if (pc != next_interpreter_pc || current_interpreter_entry == NULL) {
+        current_interpreter_entry = guest_profiler_get_entry(pc);
+        current_interpreter_entry->interpreter_count++;
+    }
+    current_interpreter_entry->interpreter_instructions++;
+    next_interpreter_pc = pc + 4;
+}
+
+void guest_profiler_request_dump() {
+    dump_requested = true;
+}
+
+void guest_profiler_check_dump() {
+    if (unlikely(dump_requested)) {
+        dump_requested = false;
+        guest_profiler_dump();
+    }
+}
+
+INLINE u64 entry_count(const guest_profile_entry_t* entry) {
+    return entry->jit_count + entry->interpreter_count;
+}
+
+INLINE u64 entry_cycles(const guest_profile_entry_t* entry) {
+    return (entry->interpreter_instructions + entry->jit_count * entry->block_length) * CYCLES_PER_INSTR;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    u64 cycles_a = entry_cycles(*(const guest_profile_entry_t**)a);
+    u64 cycles_b = entry_cycles(*(const guest_profile_entry_t**)b);
+    return cycles_a < cycles_b ? 1 : cycles_a > cycles_b ? -1 : 0;
+}
+
+void guest_profiler_dump() {
+    guest_profile_entry_t** sorted = malloc(num_entries * sizeof(guest_profile_entry_t*));
+    int n = 0;
+    u64 total_cycles = 0;
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+        for (guest_profile_entry_t* entry = buckets[i]; entry != NULL; entry = entry->next) {
+            sorted[n++] = entry;
+            total_cycles += entry_cycles(entry);
+        }
+    }
+    qsort(sorted, n, sizeof(guest_profile_entry_t*), compare_entries);
+
+    FILE* report = report_path ? fopen(report_path, "w") : stdout;
+    if (report) {
+        fprintf(report, "Guest profile: %d blocks, %" PRIu64 " cycles (JIT cycles are estimated from block length)\n", n, total_cycles);
+        fprintf(report, "%-18s %-10s %14s %16s %7s\n", "vaddr", "paddr", "entries", "cycles", "%");
+        for (int i = 0; i < n; i++) {
+            guest_profile_entry_t* entry = sorted[i];
+            u64 cycles = entry_cycles(entry);
+            double percent = total_cycles ? (100.0 * cycles) / total_cycles : 0;
+            fprintf(report, "0x%016" PRIX64 " 0x%08X %14" PRIu64 " %16" PRIu64 " %6.2f%%\n",
+                    entry->virtual_address, entry->physical_address, entry_count(entry), cycles, percent);
+        }
+        if (report != stdout) {
+            fclose(report);
+            logalways("Wrote guest profile to %s", report_path);
+        }
+    } else {
+        logwarn("Unable to open %s for the guest profile", report_path);
+    }
+
+    // One frame per block, which flamegraph.pl and speedscope both accept.
+    if (folded_path) {
+        FILE* folded = fopen(folded_path, "w");
+        if (folded) {
+            for (int i = 0; i < n; i++) {
+                fprintf(folded, "n64;0x%016" PRIX64 " %" PRIu64 "\n", sorted[i]->virtual_address, entry_cycles(sorted[i]));
+            }
+            fclose(folded);
+            logalways("Wrote folded guest profile to %s", folded_path);
+        } else {
+            logwarn("Unable to open %s for the folded guest profile", folded_path);
+        }
+    }
+
+    free(sorted);
+}
+#endif
@@ -0,0 +1,31 @@
+#ifndef N64_GUEST_PROFILER_H
+#define N64_GUEST_PROFILER_H
+
+#include <util.h>
+
+// Counts how often each guest block is entered, and how many guest instructions run in it, to find hot spots.
+// Only compiled in with N64_GUEST_PROFILER defined, the JIT then emits a counter increment in every block prologue.
+// Results are written on exit, or on SIGQUIT while running.
+
+#ifdef N64_GUEST_PROFILER
+typedef struct guest_profile_entry {
+    // Incremented by compiled code, must stay the first member
+    u64 jit_count;
+    u64 interpreter_count;
+    u64 interpreter_instructions;
+    u64 virtual_address;
+    u32 physical_address;
+    // Length of the compiled block, used to estimate instructions run by the JIT
+    u32 block_length;
+    struct guest_profile_entry* next;
+} guest_profile_entry_t;
+
+void guest_profiler_init(const char* report_path, const char* folded_path);
+guest_profile_entry_t* guest_profiler_get_entry(u64 virtual_address);
+void guest_profiler_interpreter_step(u64 pc);
+void guest_profiler_request_dump();
+void guest_profiler_check_dump();
+void guest_profiler_dump();
+#endif
+
+#endif //N64_GUEST_PROFILER_H
@@ -851,6 +851,9 @@ bool instruction_stable(mips_instruction_t instr) {
 
 void cp0_status_updated() {
     bool exception = N64CPU.cp0.status.exl || N64CPU.cp0.status.erl;
+    bool was_kernel_mode = N64CPU.cp0.kernel_mode;
+    bool was_64bit_addressing = N64CPU.cp0.is_64bit_addressing;
+    bool was_fr = n64dynarec.sysconfig.fr;
 
     N64CPU.cp0.kernel_mode     =  exception || N64CPU.cp0.status.ksu == CPU_MODE_KERNEL;
     N64CPU.cp0.supervisor_mode = !exception && N64CPU.cp0.status.ksu == CPU_MODE_SUPERVISOR;
@@ -860,5 +863,10 @@ void cp0_status_updated() {
             || (N64CPU.cp0.supervisor_mode && N64CPU.cp0.status.sx)
                || (N64CPU.cp0.user_mode && N64CPU.cp0.status.ux);
     n64dynarec.sysconfig.fr = N64CP0.status.fr;
+
+    // Linked blocks skip address translation and the sysconfig check
+    if (was_kernel_mode != N64CPU.cp0.kernel_mode || was_64bit_addressing != N64CPU.cp0.is_64bit_addressing || was_fr != n64dynarec.sysconfig.fr) {
+        unlink_dynarec_blocks();
+    }
     r4300i_interrupt_update();
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "disassemble.h"
 
 rsp_t n64rsp;
+bool rsp_run_to_completion_enabled = false;
 
 bool rsp_acquire_semaphore() {
     if (N64RSP.semaphore_held) {
@@ -354,6 +355,32 @@ void rsp_run() {
 
 void rsp_dynarec_run() {
     int run_for = 0;
+    // The RSP was busy for that long, even if the CPU already saw it halt
+    if (N64RSP.step_debt > 0 && N64RSP.steps > 0) {
+        int paid = N64RSP.step_debt < N64RSP.steps ? N64RSP.step_debt : N64RSP.steps;
+        N64RSP.step_debt -= paid;
+        N64RSP.steps -= paid;
+    }
+
+    if (N64RSP.run_to_completion && N64RSP.steps > 0) {
+        N64RSP.run_to_completion = false;
+        // Nothing in the task depends on when the CPU sees it finish, so don't stop and start it.
+        // Whatever it runs beyond the steps it was given is paid back out of the next ones, also after it halts,
+        // since the CPU loops drop the steps of a halted RSP.
+        int given = N64RSP.steps;
+        N64RSP.steps = RSP_RUN_TO_COMPLETION_MAX_STEPS;
+        while (N64RSP.steps > 0) {
+            int taken = rsp_dynarec_step();
+            N64RSP.steps -= taken;
+            run_for += taken;
+        }
+        if (N64RSP.status.halt) {
+            N64RSP.step_debt += run_for > given ? run_for - given : 0;
+        } else {
+            N64RSP.steps = given - run_for;
+        }
+    }
+
     // This is set to 0 by the break instruction, and when halted by a write to SP_STATUS_REG
     while (N64RSP.steps > 0) {
         int taken = rsp_dynarec_step();
@@ -10,6 +10,7 @@
 #include <mem/n64bus.h>
 #include <cpu/dynarec/dynarec.h>
 #include <mem/mem_util.h>
+#include <system/rsp_thread.h>
 
 #include "rsp_types.h"
 #include "rsp_interface.h"
@@ -119,6 +120,19 @@
 #define RSP_DRAM_ADDR_MASK 0xFFFFF8
 #define RSP_MEM_ADDR_MASK 0xFF8
 
+// The OSTask structure, placed at the end of DMEM by osSpTaskLoad()
+#define RSP_TASK_TYPE        0xFC0
+#define RSP_TASK_UCODE_DATA  0xFD8
+#define RSP_TASK_DATA_PTR    0xFF0
+#define RSP_TASK_DATA_SIZE   0xFF4
+
+#define RSP_TASK_TYPE_GRAPHICS 1
+#define RSP_TASK_TYPE_AUDIO    2
+#define RSP_TASK_TYPE_JPEG     4
+
+// Upper bound on steps for a task run to completion, in case it waits on the CPU after all.
+#define RSP_RUN_TO_COMPLETION_MAX_STEPS 10000000
+
 #define FLAGREG_BOOL(x) ((x) ? 0xFFFF : 0)
 
 extern rsp_t n64rsp;
@@ -130,13 +144,27 @@ INLINE void quick_invalidate_rsp_icache(u32 address) {
 
     N64RSP.icache[index].handler = cache_rsp_instruction;
     N64RSP.icache[index].instruction.raw = word_from_byte_array(N64RSP.sp_imem, address);
-    N64RSPDYNAREC->blockcache[index].run = rsp_missing_block_handler;
+    // Compiled blocks are looked up again by IMEM contents before the RSP runs next, see rsp_dynarec_select_ucode()
+    N64RSPDYNAREC->imem_dirty = true;
 }
 
 INLINE void invalidate_rsp_icache(u32 address) {
     quick_invalidate_rsp_icache(address & 0xFFC);
 }
 
+// Rows never cross the end of RDRAM's DMA window, but can wrap around the end of DMEM/IMEM, at most once.
+INLINE void rsp_dma_copy_to_mem(u8* mem, u32 mem_address, const u8* rdram, u32 length) {
+    u32 first = MIN(length, SP_DMEM_SIZE - mem_address);
+    memcpy(mem + mem_address, rdram, first);
+    memcpy(mem, rdram + first, length - first);
+}
+
+INLINE void rsp_dma_copy_from_mem(u8* rdram, const u8* mem, u32 mem_address, u32 length) {
+    u32 first = MIN(length, SP_DMEM_SIZE - mem_address);
+    memcpy(rdram, mem + mem_address, first);
+    memcpy(rdram + first, mem, length - first);
+}
+
 INLINE void rsp_dma_read() {
     u32 length = N64RSP.io.dma.length + 1;
 
@@ -154,19 +182,11 @@ INLINE void rsp_dma_read() {
         logwarn("Misaligned MEM RSP DMA READ! (from 0x%08X, aligned to 0x%08X)", mem_addr_reg.address, mem_address);
     }
 
-    for (int i = 0; i < N64RSP.io.dma.count + 1; i++) {
-        u8* mem = (mem_addr_reg.imem ? N64RSP.sp_imem : N64RSP.sp_dmem);
-        u8* rdram = n64sys.mem.rdram + dram_address;
-        for (int j = 0; j < length; j++) {
-            u16 addr = (mem_address + j) & 0xFFF;
-            mem[addr] = rdram[j];
-        }
-
-        if (mem_addr_reg.imem) {
-            for (int j = 0; j < length; j += 4) {
-                quick_invalidate_rsp_icache((mem_address + j) & 0xFFF);
-            }
-        }
+    u8* mem = (mem_addr_reg.imem ? N64RSP.sp_imem : N64RSP.sp_dmem);
+    u32 mem_start = mem_address;
+    int rows = N64RSP.io.dma.count + 1;
+    for (int i = 0; i < rows; i++) {
+        rsp_dma_copy_to_mem(mem, mem_address, n64sys.mem.rdram + dram_address, length);
 
         int skip = i == N64RSP.io.dma.count ? 0 : N64RSP.io.dma.skip;
 
@@ -176,6 +196,14 @@ INLINE void rsp_dma_read() {
         mem_address &= RSP_MEM_ADDR_MASK;
     }
 
+    // Rows are contiguous in IMEM, so everything written is one (possibly wrapping) range starting at mem_start.
+    if (mem_addr_reg.imem) {
+        u32 written = MIN(length * rows, SP_IMEM_SIZE);
+        for (u32 j = 0; j < written; j += 4) {
+            quick_invalidate_rsp_icache((mem_start + j) & 0xFFF);
+        }
+    }
+
     // Set registers for reading now that DMA is complete
     N64RSP.io.dram_addr.address = dram_address;
     N64RSP.io.mem_addr.address = mem_address;
@@ -203,19 +231,25 @@ INLINE void rsp_dma_write() {
         logwarn("Misaligned MEM RSP DMA WRITE! 0x%08X", mem_addr.address);
     }
 
+    u8* mem = (mem_addr.imem ? N64RSP.sp_imem : N64RSP.sp_dmem);
+    // Rows usually share pages, only invalidate each one once.
+    s64 last_invalidated_page = -1;
     for (int i = 0; i < N64RSP.io.dma.count + 1; i++) {
-        u8* mem = (mem_addr.imem ? N64RSP.sp_imem : N64RSP.sp_dmem);
-        u8* rdram = n64sys.mem.rdram + dram_address;
-        for (int j = 0; j < length; j++) {
-            u16 addr = (mem_address + j) & 0xFFF;
-            rdram[j] = mem[addr];
-        }
-
+        rsp_dma_copy_from_mem(n64sys.mem.rdram + dram_address, mem, mem_address, length);
 
         // Invalidate all pages touched by the DMA
         // This is probably unnecessary, since why would someone be copying code from the RSP to the CPU and then executing it?
-        for (int j = 0; j < length; j += BLOCKCACHE_PAGE_SIZE) {
-            invalidate_dynarec_page(dram_address + j);
+        u32 row_end = dram_address + length;
+        for (s64 page = dram_address >> BLOCKCACHE_OUTER_SHIFT; page <= (row_end - 1) >> BLOCKCACHE_OUTER_SHIFT; page++) {
+            if (page == last_invalidated_page) {
+                continue;
+            }
+            u32 page_address = page << BLOCKCACHE_OUTER_SHIFT;
+            u32 start = MAX(dram_address, page_address);
+            u32 end = MIN(row_end, page_address + BLOCKCACHE_PAGE_SIZE);
+            if (rsp_thread_defer_invalidate(page_address) || invalidate_dynarec_page_range(start, end - start)) {
+                last_invalidated_page = page;
+            }
         }
 
         int skip = i == N64RSP.io.dma.count ? 0 : N64RSP.io.dma.skip;
@@ -408,6 +442,8 @@ INLINE void rsp_set_vce(u16 vce) {
     }
 }
 
+extern bool rsp_run_to_completion_enabled;
+
 void rsp_step();
 void rsp_run();
 void rsp_dynarec_run();
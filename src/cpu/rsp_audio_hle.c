@@ -0,0 +1,674 @@
+#include "rsp_audio_hle.h"
+
+#ifdef N64_USE_SIMD
+#include <emmintrin.h>
+#endif
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <log.h>
+#include "rsp.h"
+
+bool rsp_audio_hle_enabled = false;
+
+static const char* dump_directory = NULL;
+static int num_dumps = 0;
+
+static rsp_audio_hle_range_t* save_log = NULL;
+static int* save_log_count = NULL;
+static int save_log_max = 0;
+
+// ABI1 buffer addresses are relative to here
+#define AUDIO_DMEM_BASE 0x5C0
+#define AUDIO_NUM_SEGMENTS 16
+
+#define A_INIT 0x01
+#define A_LOOP 0x02
+#define A_LEFT 0x02
+#define A_VOL  0x04
+#define A_AUX  0x08
+
+// The resample filter, 64 phases of 4 taps. Read out of the microcode's data segment rather than copied in here.
+#define RESAMPLE_LUT_ENTRIES (64 * 4)
+static bool resample_lut_loaded = false;
+static bool resample_lut_missing = false;
+static s16 resample_lut[RESAMPLE_LUT_ENTRIES];
+static const s16 resample_lut_first_row[] = { 0x0C39, 0x66AD, 0x0D46, (s16)0xFFDF };
+
+typedef struct audio_ramp {
+    s32 value;
+    s32 step;
+    s32 target;
+} audio_ramp_t;
+
+// Everything the microcode keeps in DMEM between commands
+static struct {
+    u32 segments[AUDIO_NUM_SEGMENTS];
+
+    u16 in;
+    u16 out;
+    u16 count;
+
+    u16 dry_right;
+    u16 wet_left;
+    u16 wet_right;
+
+    s16 dry;
+    s16 wet;
+
+    s16 vol[2];
+    s16 target[2];
+    s32 rate[2];
+
+    u32 loop;
+
+    s16 table[16 * 8];
+} audio;
+
+INLINE u32 align_up(u32 x, u32 alignment) {
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+INLINE s16 clamp_s16(s32 x) {
+    if (x > 32767) {
+        return 32767;
+    } else if (x < -32768) {
+        return -32768;
+    }
+    return x;
+}
+
+INLINE u8* dmem_u8(u16 address) {
+    return &N64RSP.sp_dmem[BYTE_ADDRESS(address & 0xFFF)];
+}
+
+INLINE s16* dmem_s16(u16 address) {
+    return (s16*)&N64RSP.sp_dmem[HALF_ADDRESS(address & 0xFFE)];
+}
+
+INLINE u32 dmem_u32(u16 address) {
+    return word_from_byte_array(N64RSP.sp_dmem, address & 0xFFC);
+}
+
+INLINE s16* rdram_s16(u32 address) {
+    return (s16*)&n64sys.mem.rdram[HALF_ADDRESS(address & (N64_RDRAM_SIZE - 2))];
+}
+
+INLINE u32 rdram_u32(u32 address) {
+    return RDRAM_WORD(address & ~3);
+}
+
+// Same as the RSP's own DMA: code compiled from RDRAM we write over has to go.
+static void rdram_written(u32 address, u32 length) {
+    address &= N64_RDRAM_SIZE - 1;
+    if (length == 0) {
+        return;
+    }
+    u32 end = address + length;
+    u32 last_page = (end - 1) >> BLOCKCACHE_OUTER_SHIFT;
+    for (u32 page = address >> BLOCKCACHE_OUTER_SHIFT; page <= last_page; page++) {
+        u32 page_address = page << BLOCKCACHE_OUTER_SHIFT;
+        u32 start = MAX(address, page_address);
+        invalidate_dynarec_page_range(start, MIN(end, page_address + BLOCKCACHE_PAGE_SIZE) - start);
+    }
+}
+
+// Sum of x[i] * y[count - 1 - i]
+INLINE s32 rdot(int count, const s16* x, const s16* y) {
+    s32 accum = 0;
+    for (int i = 0; i < count; i++) {
+        accum += x[i] * y[count - 1 - i];
+    }
+    return accum;
+}
+
+static u32 get_address(u32 segmented) {
+    u32 segment = (segmented >> 24) & 0x3F;
+    u32 offset = segmented & 0xFFFFFF;
+    if (segment >= AUDIO_NUM_SEGMENTS) {
+        logwarn("Audio HLE: segment %d out of range", segment);
+        return offset;
+    }
+    return audio.segments[segment] + offset;
+}
+
+static void load_resample_lut(u32 ucode_data) {
+    // The data segment is what gets loaded into DMEM, it can't be larger than that.
+    for (u32 offset = 0; offset + sizeof(resample_lut) <= SP_DMEM_SIZE; offset += 2) {
+        bool match = true;
+        for (int i = 0; i < 4 && match; i++) {
+            match = *rdram_s16(ucode_data + offset + i * 2) == resample_lut_first_row[i];
+        }
+        if (match) {
+            for (int i = 0; i < RESAMPLE_LUT_ENTRIES; i++) {
+                resample_lut[i] = *rdram_s16(ucode_data + offset + i * 2);
+            }
+            resample_lut_loaded = true;
+            logdebug("Audio HLE: found the resample table at offset 0x%03X in the microcode data", offset);
+            return;
+        }
+    }
+    resample_lut_missing = true;
+    logwarn("Audio HLE: resample table not found in the microcode data, audio tasks will run on the RSP");
+}
+
+static bool is_supported_task() {
+    if (dmem_u32(RSP_TASK_TYPE) != RSP_TASK_TYPE_AUDIO) {
+        return false;
+    }
+
+    u32 ucode_data = dmem_u32(RSP_TASK_UCODE_DATA);
+    if (rdram_u32(ucode_data) != 0x00000001 || rdram_u32(ucode_data + 0x30) != 0xF0000F00) {
+        return false;
+    }
+    // Other values here are variants of ABI1 with different command tables (GoldenEye, Blast Corps), or later ABIs.
+    if (rdram_u32(ucode_data + 0x28) != 0x1E24138C) {
+        return false;
+    }
+
+    if (!resample_lut_loaded && !resample_lut_missing) {
+        load_resample_lut(ucode_data);
+    }
+    return resample_lut_loaded;
+}
+
+static void audio_clear(u16 dmem, u16 count) {
+    while (count != 0) {
+        *dmem_u8(dmem++) = 0;
+        count--;
+    }
+}
+
+static void audio_load(u16 dmem, u32 address, u16 count) {
+    // Same alignment the DMA engine enforces
+    dmem &= ~3;
+    address &= ~7;
+    count = align_up(count, 8);
+    rsp_dma_copy_to_mem(N64RSP.sp_dmem, dmem, n64sys.mem.rdram + (address & (N64_RDRAM_SIZE - 1)), count);
+}
+
+static void audio_save(u16 dmem, u32 address, u16 count) {
+    dmem &= ~3;
+    address &= ~7;
+    count = align_up(count, 8);
+    address &= N64_RDRAM_SIZE - 1;
+    rsp_dma_copy_from_mem(n64sys.mem.rdram + address, N64RSP.sp_dmem, dmem, count);
+    rdram_written(address, count);
+
+    if (save_log && *save_log_count < save_log_max) {
+        save_log[*save_log_count].address = address;
+        save_log[*save_log_count].length = count;
+        (*save_log_count)++;
+    }
+}
+
+static void audio_move(u16 dmemo, u16 dmemi, u16 count) {
+    // Byte by byte, overlapping moves behave like the microcode's
+    while (count != 0) {
+        *dmem_u8(dmemo++) = *dmem_u8(dmemi++);
+        count--;
+    }
+}
+
+INLINE s16 adpcm_predict_sample(u8 byte, u8 mask, unsigned lshift, unsigned rshift) {
+    s16 sample = (u16)(byte & mask) << lshift;
+    return sample >> rshift;
+}
+
+static void adpcm_compute_residuals(s16* dst, const s16* src, const s16* cb_entry, const s16* last_samples) {
+    const s16* book1 = cb_entry;
+    const s16* book2 = cb_entry + 8;
+    s16 l1 = last_samples[0];
+    s16 l2 = last_samples[1];
+
+    for (int i = 0; i < 8; i++) {
+        s32 accum = (s32)src[i] << 11;
+        accum += book1[i] * l1 + book2[i] * l2 + rdot(i, book2, src);
+        dst[i] = clamp_s16(accum >> 11);
+    }
+}
+
+static void audio_adpcm(bool init, bool loop, u16 dmemo, u16 dmemi, u16 count, u32 last_frame_address) {
+    s16 last_frame[16];
+
+    if (init) {
+        memset(last_frame, 0, sizeof(last_frame));
+    } else {
+        u32 address = loop ? audio.loop : last_frame_address;
+        for (int i = 0; i < 16; i++) {
+            last_frame[i] = *rdram_s16(address + i * 2);
+        }
+    }
+
+    for (int i = 0; i < 16; i++, dmemo += 2) {
+        *dmem_s16(dmemo) = last_frame[i];
+    }
+
+    while (count != 0) {
+        u8 code = *dmem_u8(dmemi++);
+        unsigned scale = code >> 4;
+        unsigned rshift = scale < 12 ? 12 - scale : 0;
+        const s16* cb_entry = audio.table + ((code & 0xF) << 4);
+
+        s16 frame[16];
+        for (int i = 0; i < 8; i++) {
+            u8 byte = *dmem_u8(dmemi++);
+            frame[i * 2 + 0] = adpcm_predict_sample(byte, 0xF0, 8, rshift);
+            frame[i * 2 + 1] = adpcm_predict_sample(byte, 0x0F, 12, rshift);
+        }
+
+        adpcm_compute_residuals(last_frame + 0, frame + 0, cb_entry, last_frame + 14);
+        adpcm_compute_residuals(last_frame + 8, frame + 8, cb_entry, last_frame + 6);
+
+        for (int i = 0; i < 16; i++, dmemo += 2) {
+            *dmem_s16(dmemo) = last_frame[i];
+        }
+
+        count -= 32;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        *rdram_s16(last_frame_address + i * 2) = last_frame[i];
+    }
+    rdram_written(last_frame_address, sizeof(last_frame));
+}
+
+static void audio_resample(bool init, u16 dmemo, u16 dmemi, u16 count, u32 pitch, u32 address) {
+    // Positions are in samples. The four samples before the input carry over from the last call.
+    u16 ipos = (dmemi >> 1) - 4;
+    u16 opos = dmemo >> 1;
+    u32 pitch_accum;
+    count >>= 1;
+
+    if (init) {
+        for (int i = 0; i < 4; i++) {
+            *dmem_s16((ipos + i) << 1) = 0;
+        }
+        pitch_accum = 0;
+    } else {
+        for (int i = 0; i < 4; i++) {
+            *dmem_s16((ipos + i) << 1) = *rdram_s16(address + i * 2);
+        }
+        pitch_accum = (u16)*rdram_s16(address + 8);
+    }
+
+    while (count != 0) {
+        const s16* lut = resample_lut + ((pitch_accum & 0xFC00) >> 8);
+
+        s32 accum = *dmem_s16((ipos + 0) << 1) * lut[0]
+                  + *dmem_s16((ipos + 1) << 1) * lut[1]
+                  + *dmem_s16((ipos + 2) << 1) * lut[2]
+                  + *dmem_s16((ipos + 3) << 1) * lut[3];
+        *dmem_s16(opos++ << 1) = clamp_s16(accum >> 15);
+
+        pitch_accum += pitch;
+        ipos += pitch_accum >> 16;
+        pitch_accum &= 0xFFFF;
+        count--;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        *rdram_s16(address + i * 2) = *dmem_s16((ipos + i) << 1);
+    }
+    *rdram_s16(address + 8) = pitch_accum;
+    rdram_written(address, 10);
+}
+
+INLINE s16 ramp_step(audio_ramp_t* ramp) {
+    ramp->value += ramp->step;
+
+    bool target_reached = ramp->step <= 0 ? ramp->value <= ramp->target : ramp->value >= ramp->target;
+    if (target_reached) {
+        ramp->value = ramp->target;
+        ramp->step = 0;
+    }
+
+    return ramp->value >> 16;
+}
+
+// State carried between ENVMIXER commands on the same voice, in the 80 bytes the game reserves for it. Kept big endian
+// at fixed offsets like everything else the microcode DMAs out, so a voice can be picked up by either implementation.
+#define ENVMIX_STATE_WET      0x00
+#define ENVMIX_STATE_DRY      0x02
+#define ENVMIX_STATE_TARGET   0x04
+#define ENVMIX_STATE_EXP_RATE 0x0C
+#define ENVMIX_STATE_EXP_SEQ  0x14
+#define ENVMIX_STATE_VALUE    0x1C
+#define ENVMIX_STATE_SIZE     0x24
+
+static void audio_envmix_exp(bool init, bool aux, u32 address) {
+    audio_ramp_t ramps[2];
+    s32 exp_seq[2];
+    s32 exp_rate[2];
+    s16 dry = audio.dry;
+    s16 wet = audio.wet;
+
+    if (init) {
+        for (int i = 0; i < 2; i++) {
+            ramps[i].value = audio.vol[i] << 16;
+            ramps[i].target = audio.target[i] << 16;
+            exp_rate[i] = audio.rate[i];
+            exp_seq[i] = (s32)((s64)audio.vol[i] * audio.rate[i]);
+        }
+    } else {
+        wet = *rdram_s16(address + ENVMIX_STATE_WET);
+        dry = *rdram_s16(address + ENVMIX_STATE_DRY);
+        for (int i = 0; i < 2; i++) {
+            ramps[i].target = rdram_u32(address + ENVMIX_STATE_TARGET + i * 4);
+            exp_rate[i] = rdram_u32(address + ENVMIX_STATE_EXP_RATE + i * 4);
+            exp_seq[i] = rdram_u32(address + ENVMIX_STATE_EXP_SEQ + i * 4);
+            ramps[i].value = rdram_u32(address + ENVMIX_STATE_VALUE + i * 4);
+        }
+    }
+
+    // Only ever zero once the target has been reached
+    ramps[0].step = ramps[0].target - ramps[0].value;
+    ramps[1].step = ramps[1].target - ramps[1].value;
+
+    u16 buffers[4] = { audio.out, audio.dry_right, audio.wet_left, audio.wet_right };
+    int num_buffers = aux ? 4 : 2;
+    u16 in = audio.in;
+
+    for (int y = 0; y < audio.count; y += 16) {
+        for (int i = 0; i < 2; i++) {
+            if (ramps[i].step != 0) {
+                exp_seq[i] = ((s64)exp_seq[i] * exp_rate[i]) >> 16;
+                ramps[i].step = (exp_seq[i] - ramps[i].value) >> 3;
+            }
+        }
+
+        for (int x = 0; x < 8; x++) {
+            s16 l_vol = ramp_step(&ramps[0]);
+            s16 r_vol = ramp_step(&ramps[1]);
+            s16 gains[4] = {
+                    clamp_s16((l_vol * dry + 0x4000) >> 15),
+                    clamp_s16((r_vol * dry + 0x4000) >> 15),
+                    clamp_s16((l_vol * wet + 0x4000) >> 15),
+                    clamp_s16((r_vol * wet + 0x4000) >> 15)
+            };
+            s16 sample = *dmem_s16(in);
+
+            for (int i = 0; i < num_buffers; i++) {
+                s16* dst = dmem_s16(buffers[i]);
+                *dst = clamp_s16(*dst + ((sample * gains[i]) >> 15));
+                buffers[i] += 2;
+            }
+            in += 2;
+        }
+    }
+
+    *rdram_s16(address + ENVMIX_STATE_WET) = wet;
+    *rdram_s16(address + ENVMIX_STATE_DRY) = dry;
+    for (int i = 0; i < 2; i++) {
+        RDRAM_WORD(address + ENVMIX_STATE_TARGET + i * 4) = ramps[i].target;
+        RDRAM_WORD(address + ENVMIX_STATE_EXP_RATE + i * 4) = exp_rate[i];
+        RDRAM_WORD(address + ENVMIX_STATE_EXP_SEQ + i * 4) = exp_seq[i];
+        RDRAM_WORD(address + ENVMIX_STATE_VALUE + i * 4) = ramps[i].value;
+    }
+    rdram_written(address, ENVMIX_STATE_SIZE);
+}
+
+static void audio_mix(u16 dmemo, u16 dmemi, u16 count, s16 gain) {
+    count >>= 1;
+#ifdef N64_USE_SIMD
+    // Word aligned buffers have the same layout in host memory, so whole vectors can be mixed at once.
+    // Done in 32 bits so only the final sum saturates, like the scalar path.
+    if (((dmemo | dmemi) & 3) == 0) {
+        __m128i gain_vec = _mm_set1_epi16(gain);
+        while (count >= 8 && (dmemo & 0xFFF) + 16 <= SP_DMEM_SIZE && (dmemi & 0xFFF) + 16 <= SP_DMEM_SIZE) {
+            __m128i* dst = (__m128i*)&N64RSP.sp_dmem[dmemo & 0xFFF];
+            __m128i src = _mm_loadu_si128((__m128i*)&N64RSP.sp_dmem[dmemi & 0xFFF]);
+            __m128i out = _mm_loadu_si128(dst);
+
+            __m128i lo = _mm_mullo_epi16(src, gain_vec);
+            __m128i hi = _mm_mulhi_epi16(src, gain_vec);
+            __m128i product_lo = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+            __m128i product_hi = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+
+            __m128i out_lo = _mm_srai_epi32(_mm_unpacklo_epi16(out, out), 16);
+            __m128i out_hi = _mm_srai_epi32(_mm_unpackhi_epi16(out, out), 16);
+
+            out = _mm_packs_epi32(_mm_add_epi32(out_lo, product_lo), _mm_add_epi32(out_hi, product_hi));
+            _mm_storeu_si128(dst, out);
+
+            dmemo += 16;
+            dmemi += 16;
+            count -= 8;
+        }
+    }
+#endif
+    while (count != 0) {
+        s16* dst = dmem_s16(dmemo);
+        *dst = clamp_s16(*dst + ((*dmem_s16(dmemi) * gain) >> 15));
+        dmemo += 2;
+        dmemi += 2;
+        count--;
+    }
+}
+
+static void audio_interleave(u16 dmemo, u16 left, u16 right, u16 count) {
+    // Two samples from each side at a time, an odd one at the end is dropped like the microcode does.
+    count >>= 2;
+    while (count != 0) {
+        for (int i = 0; i < 2; i++) {
+            *dmem_s16(dmemo + 0) = *dmem_s16(left);
+            *dmem_s16(dmemo + 2) = *dmem_s16(right);
+            dmemo += 4;
+            left += 2;
+            right += 2;
+        }
+        count--;
+    }
+}
+
+static void audio_polef(bool init, u16 dmemo, u16 dmemi, u16 count, s16 gain, u32 address) {
+    const s16* h1 = audio.table;
+    s16* h2 = audio.table + 8;
+    s16 h2_before[8];
+    s16 l1 = 0;
+    s16 l2 = 0;
+
+    if (!init) {
+        l1 = *rdram_s16(address + 4);
+        l2 = *rdram_s16(address + 6);
+    }
+
+    // The microcode scales the table in place, later POLEFs see the scaled values.
+    for (int i = 0; i < 8; i++) {
+        h2_before[i] = h2[i];
+        h2[i] = ((s32)h2[i] * gain) >> 14;
+    }
+
+    s16 out[8];
+    do {
+        s16 frame[8];
+        for (int i = 0; i < 8; i++, dmemi += 2) {
+            frame[i] = *dmem_s16(dmemi);
+        }
+
+        for (int i = 0; i < 8; i++) {
+            s32 accum = frame[i] * gain;
+            accum += h1[i] * l1 + h2_before[i] * l2 + rdot(i, h2, frame);
+            out[i] = clamp_s16(accum >> 14);
+            *dmem_s16(dmemo + i * 2) = out[i];
+        }
+
+        l1 = out[6];
+        l2 = out[7];
+
+        dmemo += 16;
+        count -= 16;
+    } while (count != 0);
+
+    for (int i = 0; i < 4; i++) {
+        *rdram_s16(address + i * 2) = out[4 + i];
+    }
+    rdram_written(address, 8);
+}
+
+static void audio_command(u32 w1, u32 w2) {
+    u8 flags = w1 >> 16;
+
+    switch ((w1 >> 24) & 0x7F) {
+        case 0: // SPNOOP
+            break;
+        case 1: // ADPCM
+            audio_adpcm(flags & A_INIT, flags & A_LOOP, audio.out, audio.in, align_up(audio.count, 32), get_address(w2));
+            break;
+        case 2: { // CLEARBUFF
+            u16 count = w2;
+            if (count != 0) {
+                audio_clear(AUDIO_DMEM_BASE + (u16)w1, align_up(count, 16));
+            }
+            break;
+        }
+        case 3: // ENVMIXER
+            audio_envmix_exp(flags & A_INIT, flags & A_AUX, get_address(w2));
+            break;
+        case 4: // LOADBUFF
+            if (audio.count != 0) {
+                audio_load(audio.in, get_address(w2), audio.count);
+            }
+            break;
+        case 5: // RESAMPLE
+            audio_resample(flags & A_INIT, audio.out, audio.in, align_up(audio.count, 16), (u32)(u16)w1 << 1, get_address(w2));
+            break;
+        case 6: // SAVEBUFF
+            if (audio.count != 0) {
+                audio_save(audio.out, get_address(w2), audio.count);
+            }
+            break;
+        case 7: { // SEGMENT
+            u32 segment = (w2 >> 24) & 0x3F;
+            if (segment < AUDIO_NUM_SEGMENTS) {
+                audio.segments[segment] = w2 & 0xFFFFFF;
+            } else {
+                logwarn("Audio HLE: segment %d out of range", segment);
+            }
+            break;
+        }
+        case 8: // SETBUFF
+            if (flags & A_AUX) {
+                audio.dry_right = AUDIO_DMEM_BASE + (u16)w1;
+                audio.wet_left  = AUDIO_DMEM_BASE + (u16)(w2 >> 16);
+                audio.wet_right = AUDIO_DMEM_BASE + (u16)w2;
+            } else {
+                audio.in    = AUDIO_DMEM_BASE + (u16)w1;
+                audio.out   = AUDIO_DMEM_BASE + (u16)(w2 >> 16);
+                audio.count = w2;
+            }
+            break;
+        case 9: // SETVOL
+            if (flags & A_AUX) {
+                audio.dry = w1;
+                audio.wet = w2;
+            } else {
+                int lr = (flags & A_LEFT) ? 0 : 1;
+                if (flags & A_VOL) {
+                    audio.vol[lr] = w1;
+                } else {
+                    audio.target[lr] = w1;
+                    audio.rate[lr] = w2;
+                }
+            }
+            break;
+        case 10: { // DMEMMOVE
+            u16 count = w2;
+            if (count != 0) {
+                audio_move(AUDIO_DMEM_BASE + (u16)(w2 >> 16), AUDIO_DMEM_BASE + (u16)w1, align_up(count, 16));
+            }
+            break;
+        }
+        case 11: { // LOADADPCM
+            u32 address = get_address(w2);
+            u32 count = align_up((u16)w1, 8) >> 1;
+            if (count > sizeof(audio.table) / sizeof(audio.table[0])) {
+                count = sizeof(audio.table) / sizeof(audio.table[0]);
+            }
+            for (u32 i = 0; i < count; i++) {
+                audio.table[i] = *rdram_s16(address + i * 2);
+            }
+            break;
+        }
+        case 12: // MIXER
+            audio_mix(AUDIO_DMEM_BASE + (u16)w2, AUDIO_DMEM_BASE + (u16)(w2 >> 16), align_up(audio.count, 32), (s16)w1);
+            break;
+        case 13: // INTERLEAVE
+            audio_interleave(audio.out, AUDIO_DMEM_BASE + (u16)(w2 >> 16), AUDIO_DMEM_BASE + (u16)w2, audio.count);
+            break;
+        case 14: // POLEF
+            if (audio.count != 0) {
+                audio_polef(flags & A_INIT, audio.out, audio.in, align_up(audio.count, 16), (s16)w1, get_address(w2));
+            }
+            break;
+        case 15: // SETLOOP
+            audio.loop = get_address(w2);
+            break;
+        default:
+            logwarn("Audio HLE: unknown command 0x%08X 0x%08X", w1, w2);
+            break;
+    }
+}
+
+bool rsp_audio_hle_run_task() {
+    if (!is_supported_task()) {
+        return false;
+    }
+
+    u32 address = dmem_u32(RSP_TASK_DATA_PTR);
+    u32 end = address + (dmem_u32(RSP_TASK_DATA_SIZE) & ~7);
+    for (; address != end; address += 8) {
+        audio_command(rdram_u32(address), rdram_u32(address + 4));
+    }
+
+    // Same as the microcode's break, with SIG2 meaning the task is done
+    N64RSP.status.halt = true;
+    N64RSP.status.broke = true;
+    N64RSP.status.signal_2 = true;
+    N64RSP.steps = 0;
+    if (N64RSP.status.intr_on_break) {
+        interrupt_raise(INTERRUPT_SP);
+    }
+    return true;
+}
+
+static void dump_task() {
+    if (num_dumps >= RSP_AUDIO_HLE_DUMP_MAX || dmem_u32(RSP_TASK_TYPE) != RSP_TASK_TYPE_AUDIO) {
+        return;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/audio_task_%02d.bin", dump_directory, num_dumps++);
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        logwarn("Unable to open %s to dump an audio task", path);
+        return;
+    }
+
+    u32 header[2] = { RSP_AUDIO_HLE_DUMP_MAGIC, N64RSP.pc << 2 };
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(n64sys.mem.rdram, N64_RDRAM_SIZE, 1, f);
+    fwrite(N64RSP.sp_dmem, SP_DMEM_SIZE, 1, f);
+    fwrite(N64RSP.sp_imem, SP_IMEM_SIZE, 1, f);
+    fclose(f);
+    logalways("Dumped audio task to %s", path);
+}
+
+void rsp_audio_hle_init(bool enable, const char* directory) {
+    rsp_audio_hle_enabled = enable;
+    dump_directory = directory;
+}
+
+bool rsp_audio_hle_task_started() {
+    if (unlikely(dump_directory != NULL)) {
+        dump_task();
+    }
+    return rsp_audio_hle_enabled && rsp_audio_hle_run_task();
+}
+
+void rsp_audio_hle_log_saves(rsp_audio_hle_range_t* log, int* count, int max) {
+    save_log = log;
+    save_log_count = count;
+    save_log_max = max;
+}
@@ -0,0 +1,29 @@
+#ifndef N64_RSP_AUDIO_HLE_H
+#define N64_RSP_AUDIO_HLE_H
+
+#include <util.h>
+
+// Optionally runs audio tasks in C instead of running the microcode on the RSP.
+// Only the common libultra audio microcode (ABI1) is recognized, by signature words in its data segment, since IMEM
+// only holds the boot microcode when the task is started. Anything else, and everything by default, runs on the RSP.
+
+// Task dumps are the RSP PC followed by RDRAM, DMEM and IMEM, in host order, as they were when the task was started.
+#define RSP_AUDIO_HLE_DUMP_MAGIC 0x54445541
+#define RSP_AUDIO_HLE_DUMP_MAX 16
+
+typedef struct rsp_audio_hle_range {
+    u32 address;
+    u32 length;
+} rsp_audio_hle_range_t;
+
+extern bool rsp_audio_hle_enabled;
+
+void rsp_audio_hle_init(bool enable, const char* dump_directory);
+// Called when the CPU starts the RSP. Returns true if the task was run, in which case the RSP is halted again.
+bool rsp_audio_hle_task_started();
+// Runs the task in DMEM if it's a supported audio task, regardless of whether HLE is enabled.
+bool rsp_audio_hle_run_task();
+// Records the RDRAM ranges written by SAVEBUFF, for comparing against the microcode's output.
+void rsp_audio_hle_log_saves(rsp_audio_hle_range_t* log, int* count, int max);
+
+#endif //N64_RSP_AUDIO_HLE_H
@@ -1,5 +1,8 @@
 #include "rsp_interface.h"
 #include "rsp.h"
+#include "rsp_audio_hle.h"
+#include <system/scheduler.h>
+#include <system/rsp_thread.h>
 
 typedef union sp_status_write {
     u32 raw;
@@ -47,9 +50,14 @@ void rsp_status_reg_write(u32 value) {
     sp_status_write_t write;
     write.raw = value;
 
+    bool was_halted = N64RSP.status.halt;
     CLEAR_SET(N64RSP.status.halt,          write.clear_halt,          write.set_halt);
     if (N64RSP.status.halt) {
         N64RSP.steps = 0;
+    } else if (was_halted) {
+        // The JIT loop only runs the RSP after scheduler events, make sure there are some while it's running.
+        scheduler_remove_event(SCHEDULER_RSP_SYNC);
+        scheduler_enqueue_relative(RSP_SYNC_CYCLES, SCHEDULER_RSP_SYNC);
     }
 
     CLEAR_SET(N64RSP.status.broke,         write.clear_broke,         false);
@@ -69,9 +77,18 @@ void rsp_status_reg_write(u32 value) {
     CLEAR_SET(N64RSP.status.signal_5,      write.clear_signal_5,      write.set_signal_5);
     CLEAR_SET(N64RSP.status.signal_6,      write.clear_signal_6,      write.set_signal_6);
     CLEAR_SET(N64RSP.status.signal_7,      write.clear_signal_7,      write.set_signal_7);
+
+    // Checked last, since finishing the task may need intr_on_break from this same write.
+    // Only task types known not to wait on the CPU, anything else (graphics, homebrew microcode) is time sliced.
+    if (was_halted && !N64RSP.status.halt && !rsp_audio_hle_task_started()) {
+        u32 type = word_from_byte_array(N64RSP.sp_dmem, RSP_TASK_TYPE);
+        N64RSP.run_to_completion = rsp_run_to_completion_enabled
+                && (type == RSP_TASK_TYPE_AUDIO || type == RSP_TASK_TYPE_JPEG);
+    }
 }
 
 u32 read_word_spreg(u32 address) {
+    rsp_thread_sync();
     switch (address) {
         case ADDR_SP_MEM_ADDR_REG:
             return N64RSP.io.mem_addr.raw;
@@ -94,6 +111,7 @@ u32 read_word_spreg(u32 address) {
 }
 
 void write_word_spreg(u32 address, u32 value) {
+    rsp_thread_sync();
     switch (address) {
         case ADDR_SP_MEM_ADDR_REG:
             N64RSP.io.shadow_mem_addr.raw = value;
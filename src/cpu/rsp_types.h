@@ -7,14 +7,15 @@
 #include <emmintrin.h>
 #endif
 #include <util.h>
+
+#define SP_DMEM_SIZE 0x1000
+#define SP_IMEM_SIZE 0x1000
+
 #include <cpu/dynarec/rsp_dynarec.h>
 #include "mips_instruction_decode.h"
 
 #define vecr __m128i
 
-#define SP_DMEM_SIZE 0x1000
-#define SP_IMEM_SIZE 0x1000
-
 typedef union vu_reg {
     // Used by instructions
     u8 bytes[16];
@@ -123,6 +124,10 @@ typedef struct rsp {
     u16 next_pc;
 
     int steps;
+    // Set when a task that doesn't depend on CPU timing is started, see rsp_dynarec_run()
+    bool run_to_completion;
+    // Steps a task run to completion took beyond the ones it was given, kept across halts
+    int step_debt;
 
 #ifdef N64_USE_SIMD
     vecr zero;
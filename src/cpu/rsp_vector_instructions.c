@@ -1074,13 +1074,13 @@ RSP_VECTOR_INSTR(rsp_vec_vmadm) {
 #endif
 }
 
-RSP_VECTOR_INSTR(rsp_vec_vmadn) {
-    logdebug("rsp_vec_vmadn");
+#ifdef N64_USE_SIMD
+// Everything but the final clamp, which is the only part that differs between the SSE2 and SSE4.1 kernels.
+// Returns the lanes where acc.l is used as-is in cmask, and the clamped value for the other lanes in cval.
+INLINE void vmadn_accumulate(mips_instruction_t instruction, vecr* cmask, vecr* cval) {
     defvs;
-    defvd;
     defvte;
-#ifdef N64_USE_SIMD
-    vecr lo, hi, sign, vsa, omask, nhi, nmd, shi, smd, cmask, cval;
+    vecr lo, hi, sign, vsa, omask, nhi, nmd, shi, smd;
     lo                 = _mm_mullo_epi16(vs->single, vte.single);
     hi                 = _mm_mulhi_epu16(vs->single, vte.single);
     sign               = _mm_srai_epi16(vte.single, 15);
@@ -1102,10 +1102,34 @@ RSP_VECTOR_INSTR(rsp_vec_vmadn) {
     nmd                = _mm_srai_epi16(N64RSP.acc.m.single, 15);
     shi                = _mm_cmpeq_epi16(nhi, N64RSP.acc.h.single);
     smd                = _mm_cmpeq_epi16(nhi, nmd);
-    cmask              = _mm_and_si128(smd, shi);
-    cval               = _mm_cmpeq_epi16(nhi, N64RSP.zero);
-    vd->single         = _mm_blendv_epi8(cval, N64RSP.acc.l.single, cmask);
+    *cmask             = _mm_and_si128(smd, shi);
+    *cval              = _mm_cmpeq_epi16(nhi, N64RSP.zero);
+}
+
+static void rsp_vec_vmadn_sse2(mips_instruction_t instruction) {
+    logdebug("rsp_vec_vmadn");
+    defvd;
+    vecr cmask, cval;
+    vmadn_accumulate(instruction, &cmask, &cval);
+    vd->single = _mm_or_si128(_mm_and_si128(cmask, N64RSP.acc.l.single), _mm_andnot_si128(cmask, cval));
+}
+
+#ifdef __GNUC__
+__attribute__((target("sse4.1")))
+static void rsp_vec_vmadn_sse41(mips_instruction_t instruction) {
+    logdebug("rsp_vec_vmadn");
+    defvd;
+    vecr cmask, cval;
+    vmadn_accumulate(instruction, &cmask, &cval);
+    vd->single = _mm_blendv_epi8(cval, N64RSP.acc.l.single, cmask);
+}
+#endif
 #else
+static void rsp_vec_vmadn_scalar(mips_instruction_t instruction) {
+    logdebug("rsp_vec_vmadn");
+    defvs;
+    defvd;
+    defvte;
     for (int e = 0; e < 8; e++) {
         s16 multiplicand1 = vte.elements[e];
         u16 multiplicand2 = vs->elements[e];
@@ -1128,8 +1152,8 @@ RSP_VECTOR_INSTR(rsp_vec_vmadn) {
 
         vd->elements[e] = result;
     }
-#endif
 }
+#endif
 
 RSP_VECTOR_INSTR(rsp_vec_vmov) {
     logdebug("rsp_vec_vmov");
@@ -1685,3 +1709,19 @@ RSP_VECTOR_INSTR(rsp_vec_vzero) {
     }
     memset(vd, 0, sizeof(vu_reg_t));
 }
+
+rspinstr_handler_t rsp_vec_vmadn;
+
+void rsp_vector_init() {
+#ifdef N64_USE_SIMD
+    rsp_vec_vmadn = rsp_vec_vmadn_sse2;
+#ifdef __GNUC__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {
+        rsp_vec_vmadn = rsp_vec_vmadn_sse41;
+    }
+#endif
+#else
+    rsp_vec_vmadn = rsp_vec_vmadn_scalar;
+#endif
+}
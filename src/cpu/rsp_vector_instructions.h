@@ -52,7 +52,6 @@ RSP_VECTOR_INSTR(rsp_vec_vmacu);
 RSP_VECTOR_INSTR(rsp_vec_vmadh);
 RSP_VECTOR_INSTR(rsp_vec_vmadl);
 RSP_VECTOR_INSTR(rsp_vec_vmadm);
-RSP_VECTOR_INSTR(rsp_vec_vmadn);
 RSP_VECTOR_INSTR(rsp_vec_vmov);
 RSP_VECTOR_INSTR(rsp_vec_vmrg);
 RSP_VECTOR_INSTR(rsp_vec_vmudh);
@@ -81,4 +80,9 @@ RSP_VECTOR_INSTR(rsp_vec_vsubc);
 RSP_VECTOR_INSTR(rsp_vec_vxor);
 RSP_VECTOR_INSTR(rsp_vec_vzero);
 
+// Kernels with more than one implementation, picked for the host CPU by rsp_vector_init().
+extern rspinstr_handler_t rsp_vec_vmadn;
+
+void rsp_vector_init();
+
 #endif //N64_RSP_VECTOR_INSTRUCTIONS_H
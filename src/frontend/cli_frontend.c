@@ -5,10 +5,17 @@
 #include <mem/pif.h>
 #include <rdp/rdp.h>
 #include <rdp/parallel_rdp_wrapper.h>
+#include <rdp/rdp_trace.h>
 #include <frontend/tas_movie.h>
 #include <signal.h>
 #include <imgui/imgui_ui.h>
 #include <settings.h>
+#include <dynarec/dynarec.h>
+#include <dynarec/dynarec_perf.h>
+#include <cpu/guest_profiler.h>
+#include <system/rsp_thread.h>
+#include <cpu/rsp.h>
+#include <cpu/rsp_audio_hle.h>
 #include "frontend.h"
 
 void usage(cflags_t* flags) {
@@ -22,6 +29,7 @@ void usage(cflags_t* flags) {
 void sig_handler(int signum) {
     if (signum == SIGUSR1) {
         delayed_log_set_verbosity(LOG_VERBOSITY_DEBUG);
+        rdp_trace_request_dump();
     } else if (signum == SIGUSR2) {
         delayed_log_set_verbosity(LOG_VERBOSITY_WARN);
     }
@@ -48,6 +56,17 @@ int main(int argc, char** argv) {
     bool software_mode = false;
     cflags_add_bool(flags, 's', "software-mode", &software_mode, "Use software mode RDP (UNFINISHED!)");
 
+    int softrdp_threads = 1;
+    cflags_add_int(flags, '\0', "softrdp-threads", &softrdp_threads, "Rasterize on this many threads in software mode, 0 for one per core");
+
+    bool softrdp_thread = false;
+    cflags_add_bool(flags, '\0', "softrdp-thread", &softrdp_thread, "Run software mode RDP commands on their own thread, alongside emulation");
+
+#ifdef N64_RDP_TRACE
+    const char* rdp_trace_path = NULL;
+    cflags_add_string(flags, '\0', "rdp-trace", &rdp_trace_path, "Write the software RDP trace here instead of stdout, on exit and on SIGUSR1");
+#endif
+
     bool debug = false;
 #ifdef N64_DEBUG_MODE
 #ifndef N64_WIN
@@ -66,6 +85,38 @@ int main(int argc, char** argv) {
     const char* pif_rom_path = NULL;
     cflags_add_string(flags, 'p', "pif", &pif_rom_path, "Load PIF ROM");
 
+    bool mprotect_smc = false;
+    cflags_add_bool(flags, '\0', "mprotect-smc", &mprotect_smc, "Detect self-modifying code by write protecting RDRAM pages containing compiled code");
+
+    bool rsp_thread = false;
+    cflags_add_bool(flags, '\0', "rsp-thread", &rsp_thread, "Run the RSP on its own thread (JIT only)");
+
+    int rsp_thread_tolerance = RSP_THREAD_DEFAULT_TOLERANCE;
+    cflags_add_int(flags, '\0', "rsp-thread-tolerance", &rsp_thread_tolerance, "How many steps the RSP thread may fall behind the CPU before the CPU waits for it");
+
+    bool rsp_run_to_completion = false;
+    cflags_add_bool(flags, '\0', "rsp-run-to-completion", &rsp_run_to_completion, "Run audio and JPEG RSP tasks to the end in one go (JIT only)");
+
+    bool audio_hle = false;
+    cflags_add_bool(flags, '\0', "audio-hle", &audio_hle, "Run recognized audio microcode in C instead of on the RSP");
+
+    const char* audio_dump_directory = NULL;
+    cflags_add_string(flags, '\0', "dump-audio-tasks", &audio_dump_directory, "Dump the first few audio tasks to this directory, for tests/test_audio_hle");
+
+    bool perf_map = false;
+    cflags_add_bool(flags, '\0', "perf-map", &perf_map, "Write /tmp/perf-<pid>.map so perf can name compiled blocks");
+
+    bool jitdump = false;
+    cflags_add_bool(flags, '\0', "jitdump", &jitdump, "Write /tmp/jit-<pid>.dump for perf inject --jit");
+
+#ifdef N64_GUEST_PROFILER
+    const char* profile_report_path = NULL;
+    cflags_add_string(flags, '\0', "profile-report", &profile_report_path, "Write the guest profile report here instead of stdout");
+
+    const char* profile_folded_path = NULL;
+    cflags_add_string(flags, '\0', "profile-folded", &profile_folded_path, "Also write the guest profile as folded stacks, for flamegraphs");
+#endif
+
     cflags_parse(flags, argc, argv);
 
     if (record_tas_movie && tas_movie_path == NULL) {
@@ -96,6 +147,15 @@ int main(int argc, char** argv) {
         }
         init_n64system(rom_path, true, debug, SOFTWARE_VIDEO_TYPE, interpreter);
         softrdp_init(&n64sys.softrdp_state, (u8 *) &n64sys.mem.rdram);
+#ifdef N64_RDP_TRACE
+        rdp_trace_init(rdp_trace_path);
+#endif
+        if (softrdp_threads != 1) {
+            softrdp_start_workers(&n64sys.softrdp_state, softrdp_threads);
+        }
+        if (softrdp_thread) {
+            softrdp_start_thread(&n64sys.softrdp_state);
+        }
     } else {
         const char* rom_path = NULL;
         if (flags->argc >= 1) {
@@ -106,6 +166,30 @@ int main(int argc, char** argv) {
         load_imgui_ui();
         register_imgui_event_handler(imgui_handle_event);
     }
+    if (mprotect_smc && !interpreter) {
+        if (rsp_thread) {
+            // RSP DMA would fault on protected pages from the RSP thread.
+            logwarn("--mprotect-smc can't be used with --rsp-thread, ignoring it");
+        } else if (software_mode && (softrdp_threads != 1 || softrdp_thread)) {
+            // Same for the software RDP writing the framebuffer from its own threads.
+            logwarn("--mprotect-smc can't be used with --softrdp-threads or --softrdp-thread, ignoring it");
+        } else {
+            n64_dynarec_enable_smc_mprotect();
+        }
+    }
+    if (rsp_thread && !interpreter) {
+        rsp_thread_init(rsp_thread_tolerance);
+    }
+    rsp_run_to_completion_enabled = rsp_run_to_completion && !interpreter;
+    if (audio_hle || audio_dump_directory) {
+        rsp_audio_hle_init(audio_hle, audio_dump_directory);
+    }
+    if (perf_map || jitdump) {
+        dynarec_perf_init(perf_map, jitdump);
+    }
+#ifdef N64_GUEST_PROFILER
+    guest_profiler_init(profile_report_path, profile_folded_path);
+#endif
     if (tas_movie_path != NULL) {
         if (record_tas_movie) {
             start_tas_recording(tas_movie_path);
@@ -175,6 +175,8 @@ static void vi_scanout_32bit() {
 
 void render_screen_software() {
     n64_poll_input();
+    // The VI reads the framebuffer straight out of RDRAM
+    softrdp_flush(&n64sys.softrdp_state);
 
     switch (n64sys.vi.status.type) {
         case VI_TYPE_BLANK:
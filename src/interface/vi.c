@@ -40,7 +40,9 @@ void write_word_vireg(u32 address, u32 value) {
             break;
         }
         case ADDR_VI_V_INTR_REG:
+            vi_catch_up();
             n64sys.vi.vi_v_intr = value & 0x3FF;
+            vi_schedule_interrupt();
             loginfo("VI interrupt is now 0x%X (wrote 0x%08X) will VI interrupt when v_current == %d", value & 0x3FF, value, value >> 1);
             break;
         case ADDR_VI_V_CURRENT_REG:
@@ -51,12 +53,16 @@ void write_word_vireg(u32 address, u32 value) {
             n64sys.vi.vi_burst.raw = value;
             break;
         case ADDR_VI_V_SYNC_REG:
+            vi_catch_up();
             n64sys.vi.vsync = value & 0x3FF;
             n64sys.vi.num_halflines = n64sys.vi.vsync >> 1;
             n64sys.vi.cycles_per_halfline = CPU_CYCLES_PER_FRAME / n64sys.vi.num_halflines;
             n64sys.vi.missing_cycles = CPU_CYCLES_PER_FRAME % n64sys.vi.num_halflines;
-            scheduler_remove_event(SCHEDULER_VI_HALFLINE);
-            scheduler_enqueue_relative((u64)n64sys.vi.cycles_per_halfline, SCHEDULER_VI_HALFLINE);
+            if (n64sys.vi.halfline > n64sys.vi.num_halflines) {
+                n64sys.vi.halfline = n64sys.vi.num_halflines;
+            }
+            vi_schedule_interrupt();
+            vi_schedule_field_complete();
             loginfo("VI vsync is now 0x%X / %d, wrote 0x%08X", value & 0x3FF, value & 0x3FF, value);
             break;
         case ADDR_VI_H_SYNC_REG:
@@ -102,6 +108,7 @@ u32 read_word_vireg(u32 address) {
         case ADDR_VI_V_INTR_REG:
             logfatal("Reading of ADDR_VI_V_INTR_REG is unsupported");
         case ADDR_VI_V_CURRENT_REG:
+            vi_catch_up();
             return n64sys.vi.v_current;
         case ADDR_VI_BURST_REG:
             logfatal("Reading of ADDR_VI_BURST_REG is unsupported");
@@ -126,11 +133,55 @@ u32 read_word_vireg(u32 address) {
     }
 }
 
-void check_vi_interrupt() {
-    if ((n64sys.vi.v_current & 0x3FE) == n64sys.vi.vi_v_intr) {
-        logdebug("Checking for VI interrupt: %d == %d? YES", n64sys.vi.v_current % 0x3FE, n64sys.vi.vi_v_intr);
-        interrupt_raise(INTERRUPT_VI);
-    } else {
-        logdebug("Checking for VI interrupt: %d == %d? nah", n64sys.vi.v_current & 0x3FE, n64sys.vi.vi_v_intr);
+// The current halfline and field are worked out from the cycle count whenever something needs them, rather than
+// being stepped by an event every halfline. Each field has halflines 0 through num_halflines.
+void vi_catch_up() {
+    u64 elapsed = (n64scheduler.scheduler_ticks - n64sys.vi.last_halfline_at) / n64sys.vi.cycles_per_halfline;
+    if (elapsed == 0) {
+        return;
+    }
+    n64sys.vi.last_halfline_at += elapsed * n64sys.vi.cycles_per_halfline;
+
+    u64 halflines_per_field = n64sys.vi.num_halflines + 1;
+    u64 halfline = n64sys.vi.halfline + elapsed;
+    // SCHEDULER_VI_FIELD_COMPLETE catches up at the end of every field, so this only loops once or twice.
+    while (halfline >= halflines_per_field) {
+        halfline -= halflines_per_field;
+        n64sys.vi.field++;
+        if (n64sys.vi.field > n64sys.vi.num_fields) {
+            n64sys.vi.field = 0;
+        }
+    }
+    n64sys.vi.halfline = halfline;
+    n64sys.vi.v_current = (n64sys.vi.halfline << 1) + n64sys.vi.field;
+}
+
+INLINE u64 vi_time_of_halfline(u64 halflines_from_now) {
+    return n64sys.vi.last_halfline_at + halflines_from_now * n64sys.vi.cycles_per_halfline;
+}
+
+// The VI interrupt is raised when (v_current & 0x3FE) == v_intr, so an odd v_intr, or one past the last halfline,
+// never matches.
+void vi_schedule_interrupt() {
+    scheduler_remove_event(SCHEDULER_VI_INTERRUPT);
+
+    u64 target = n64sys.vi.vi_v_intr >> 1;
+    if ((n64sys.vi.vi_v_intr & 1) || target > n64sys.vi.num_halflines) {
+        logdebug("VI interrupt at v_current %d will never happen", n64sys.vi.vi_v_intr);
+        return;
     }
+
+    // If we're on the interrupt line already, it's been raised for this field.
+    u64 halflines_per_field = n64sys.vi.num_halflines + 1;
+    u64 halflines_until = (target + halflines_per_field - n64sys.vi.halfline) % halflines_per_field;
+    if (halflines_until == 0) {
+        halflines_until = halflines_per_field;
+    }
+    scheduler_enqueue_absolute(vi_time_of_halfline(halflines_until), SCHEDULER_VI_INTERRUPT);
+}
+
+void vi_schedule_field_complete() {
+    scheduler_remove_event(SCHEDULER_VI_FIELD_COMPLETE);
+    u64 halflines_until = n64sys.vi.num_halflines + 1 - n64sys.vi.halfline;
+    scheduler_enqueue_absolute(vi_time_of_halfline(halflines_until), SCHEDULER_VI_FIELD_COMPLETE);
 }
@@ -5,6 +5,8 @@
 
 void write_word_vireg(u32 address, u32 value);
 u32 read_word_vireg(u32 address);
-void check_vi_interrupt();
+void vi_catch_up();
+void vi_schedule_interrupt();
+void vi_schedule_field_complete();
 
 #endif //N64_VI_H
@@ -8,6 +8,7 @@
 #include <rsp.h>
 #include <interface/si.h>
 #include <interface/pi.h>
+#include <system/rsp_thread.h>
 
 #include "addresses.h"
 #include "pif.h"
@@ -282,11 +283,97 @@ u32 read_unused(u32 address) {
     return 0;
 }
 
+// SP_MEM and SP_REGS share a bus page, so split them here.
+u32 read_word_sp(u32 address) {
+    rsp_thread_sync();
+    if (address <= EREGION_SP_MEM) {
+        if (address & 0x1000) {
+            return word_from_byte_array((u8*) &N64RSP.sp_imem, WORD_ADDRESS(address & 0xFFF));
+        } else {
+            return word_from_byte_array((u8*) &N64RSP.sp_dmem, WORD_ADDRESS(address & 0xFFF));
+        }
+    } else {
+        return read_word_spreg(address);
+    }
+}
+
+void write_word_sp(u32 address, u32 value) {
+    rsp_thread_sync();
+    if (address <= EREGION_SP_MEM) {
+        if (address & 0x1000) {
+            word_to_byte_array((u8*) &N64RSP.sp_imem, WORD_ADDRESS(address & 0xFFF), value);
+            invalidate_rsp_icache(WORD_ADDRESS(address));
+        } else {
+            word_to_byte_array((u8*) &N64RSP.sp_dmem, WORD_ADDRESS(address & 0xFFF), value);
+        }
+    } else {
+        write_word_spreg(address, value);
+    }
+}
+
+static n64_bus_page_t bus_pages[N64_BUS_NUM_PAGES];
+
+INLINE void map_bus_mmio(u32 start, u32 end, u32 (*read_word)(u32), void (*write_word)(u32, u32), bool mmio) {
+    for (u32 page = N64_BUS_PAGE_INDEX(start); page <= N64_BUS_PAGE_INDEX(end); page++) {
+        bus_pages[page].read_word = read_word;
+        bus_pages[page].write_word = write_word;
+        bus_pages[page].mmio = mmio;
+    }
+}
+
+void n64_bus_init_pages() {
+    memset(bus_pages, 0, sizeof(bus_pages));
+
+    for (u32 page = N64_BUS_PAGE_INDEX(SREGION_RDRAM); page <= N64_BUS_PAGE_INDEX(EREGION_RDRAM); page++) {
+        bus_pages[page].ram = &n64sys.mem.rdram[(page << N64_BUS_PAGE_SHIFT) - SREGION_RDRAM];
+    }
+
+    map_bus_mmio(SREGION_RDRAM_REGS, EREGION_RDRAM_REGS, read_word_rdramreg, write_word_rdramreg, true);
+    // Not mmio: SP DMEM can hold code (IPL3 runs from it)
+    map_bus_mmio(SREGION_SP_MEM, EREGION_SP_REGS, read_word_sp, write_word_sp, false);
+    map_bus_mmio(SREGION_DP_COMMAND_REGS, EREGION_DP_COMMAND_REGS, read_word_dpcreg, write_word_dpcreg, true);
+    map_bus_mmio(SREGION_MI_REGS, EREGION_MI_REGS, read_word_mireg, write_word_mireg, true);
+    map_bus_mmio(SREGION_VI_REGS, EREGION_VI_REGS, read_word_vireg, write_word_vireg, true);
+    map_bus_mmio(SREGION_AI_REGS, EREGION_AI_REGS, read_word_aireg, write_word_aireg, true);
+    map_bus_mmio(SREGION_PI_REGS, EREGION_PI_REGS, read_word_pireg, write_word_pireg, true);
+    map_bus_mmio(SREGION_RI_REGS, EREGION_RI_REGS, read_word_rireg, write_word_rireg, true);
+    map_bus_mmio(SREGION_SI_REGS, EREGION_SI_REGS, read_word_sireg, write_word_sireg, true);
+    map_bus_mmio(SREGION_CART_2_1, SREGION_PIF_BOOT - 1, read_word_pibus, write_word_pibus, false);
+
+    // Only pages entirely backed by the ROM image are mapped directly, the rest goes through the PI handlers.
+    if (n64sys.mem.rom.rom != NULL) {
+        for (u32 page = N64_BUS_PAGE_INDEX(SREGION_CART_1_2); page < N64_BUS_PAGE_INDEX(SREGION_PIF_BOOT); page++) {
+            size_t offset = (page << N64_BUS_PAGE_SHIFT) - SREGION_CART_1_2;
+            if (offset + N64_BUS_PAGE_SIZE <= n64sys.mem.rom.size) {
+                bus_pages[page].rom = &n64sys.mem.rom.rom[offset];
+            }
+        }
+    }
+}
+
+const n64_bus_page_t* n64_bus_get_page(u32 address) {
+    return &bus_pages[N64_BUS_PAGE_INDEX(address)];
+}
+
+// ROM pages can only be read directly when the PI bus isn't holding a latched write.
+INLINE u8* bus_page_rom(const n64_bus_page_t* page) {
+    if (page->rom && likely(!n64sys.pi.io_busy)) {
+        return page->rom;
+    }
+    return NULL;
+}
+
 void n64_write_physical_dword(u32 address, u64 value) {
     if (address & 0b111) {
         logfatal("Tried to write to unaligned DWORD");
     }
     logdebug("Writing 0x%016" PRIX64 " to [0x%08X]", value, address);
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        invalidate_dynarec_ram(address);
+        dword_to_byte_array(page->ram, DWORD_ADDRESS(address & N64_BUS_PAGE_MASK), value);
+        return;
+    }
     invalidate_dynarec_page(address);
     switch (address) {
         case REGION_RDRAM:
@@ -298,6 +385,7 @@ void n64_write_physical_dword(u32 address, u64 value) {
         case REGION_RDRAM_UNUSED:
             return;
         case REGION_SP_MEM: {
+            rsp_thread_sync();
             value >>= 32; // TODO: this is probably wrong, it probably depends on the address.
             if (address & 0x1000) {
                 word_to_byte_array((u8*) &N64RSP.sp_imem, DWORD_ADDRESS(address & 0xFFF), value);
@@ -360,6 +448,14 @@ u64 n64_read_physical_dword(u32 address) {
     if (address & 0b111) {
         logfatal("Tried to load from unaligned DWORD");
     }
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        return dword_from_byte_array(page->ram, DWORD_ADDRESS(address & N64_BUS_PAGE_MASK));
+    }
+    u8* rom = bus_page_rom(page);
+    if (rom) {
+        return dword_from_byte_array(rom, DWORD_ADDRESS(address & N64_BUS_PAGE_MASK));
+    }
     switch (address) {
         case REGION_RDRAM:
             return dword_from_byte_array((u8*) &n64sys.mem.rdram, DWORD_ADDRESS(address) - SREGION_RDRAM);
@@ -368,6 +464,7 @@ u64 n64_read_physical_dword(u32 address) {
         case REGION_RDRAM_REGS:
             logfatal("Reading dword from address 0x%08X in unsupported region: REGION_RDRAM_REGS", address);
         case REGION_SP_MEM:
+            rsp_thread_sync();
             if (address & 0x1000) {
                 return dword_from_byte_array((u8*) &N64RSP.sp_imem, DWORD_ADDRESS(address & 0xFFF));
             } else {
@@ -416,7 +513,17 @@ void n64_write_physical_word(u32 address, u32 value) {
         logfatal("Tried to write to unaligned WORD");
     }
     logdebug("Writing 0x%08X to [0x%08X]", value, address);
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        invalidate_dynarec_ram(WORD_ADDRESS(address));
+        word_to_byte_array(page->ram, WORD_ADDRESS(address & N64_BUS_PAGE_MASK), value);
+        return;
+    }
     invalidate_dynarec_page(WORD_ADDRESS(address));
+    if (page->write_word) {
+        page->write_word(address, value);
+        return;
+    }
     switch (address) {
         case REGION_RDRAM:
             word_to_byte_array((u8*) &n64sys.mem.rdram, WORD_ADDRESS(address) - SREGION_RDRAM, value);
@@ -427,6 +534,7 @@ void n64_write_physical_word(u32 address, u32 value) {
         case REGION_RDRAM_UNUSED:
             return;
         case REGION_SP_MEM:
+            rsp_thread_sync();
             if (address & 0x1000) {
                 word_to_byte_array((u8*) &N64RSP.sp_imem, WORD_ADDRESS(address & 0xFFF), value);
                 invalidate_rsp_icache(WORD_ADDRESS(address));
@@ -489,6 +597,16 @@ u32 n64_read_physical_word(u32 address) {
     if (address & 0b11) {
         logfatal("Tried to load from unaligned WORD");
     }
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        return word_from_byte_array(page->ram, WORD_ADDRESS(address & N64_BUS_PAGE_MASK));
+    }
+    u8* rom = bus_page_rom(page);
+    if (rom) {
+        return word_from_byte_array(rom, WORD_ADDRESS(address & N64_BUS_PAGE_MASK));
+    } else if (page->read_word) {
+        return page->read_word(address);
+    }
     switch (address) {
         case REGION_RDRAM:
             return word_from_byte_array((u8*) &n64sys.mem.rdram, WORD_ADDRESS(address) - SREGION_RDRAM);
@@ -497,6 +615,7 @@ u32 n64_read_physical_word(u32 address) {
         case REGION_RDRAM_REGS:
             return read_word_rdramreg(address);
         case REGION_SP_MEM:
+            rsp_thread_sync();
             if (address & 0x1000) {
                 return word_from_byte_array((u8*) &N64RSP.sp_imem, WORD_ADDRESS(address & 0xFFF));
             } else {
@@ -569,6 +688,12 @@ void n64_write_physical_half(u32 address, u32 value) {
         logfatal("Tried to write to unaligned HALF");
     }
     logdebug("Writing 0x%04X to [0x%08X]", value & 0xFFFF, address);
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        invalidate_dynarec_ram(HALF_ADDRESS(address));
+        half_to_byte_array(page->ram, HALF_ADDRESS(address & N64_BUS_PAGE_MASK), value);
+        return;
+    }
     invalidate_dynarec_page(HALF_ADDRESS(address));
     switch (address) {
         case REGION_RDRAM:
@@ -580,6 +705,7 @@ void n64_write_physical_half(u32 address, u32 value) {
         case REGION_RDRAM_UNUSED:
             return;
         case REGION_SP_MEM:
+            rsp_thread_sync();
             value = bus_edge_case_half_pif_spmem(address, value);
             address &= ~3;
             if (address & 0x1000) {
@@ -645,6 +771,10 @@ u16 n64_read_physical_half(u32 address) {
     if (address & 0b1) {
         logfatal("Tried to load from unaligned HALF");
     }
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        return half_from_byte_array(page->ram, HALF_ADDRESS(address & N64_BUS_PAGE_MASK));
+    }
     switch (address) {
         case REGION_RDRAM:
             return half_from_byte_array((u8*) &n64sys.mem.rdram, HALF_ADDRESS(address) - SREGION_RDRAM);
@@ -653,6 +783,7 @@ u16 n64_read_physical_half(u32 address) {
         case REGION_RDRAM_REGS:
             logfatal("Reading u16 from address 0x%08X in unsupported region: REGION_RDRAM_REGS", address);
         case REGION_SP_MEM:
+            rsp_thread_sync();
             if (address & 0x1000) {
                 return half_from_byte_array((u8*) &N64RSP.sp_imem, HALF_ADDRESS(address & 0xFFF));
             } else {
@@ -697,6 +828,12 @@ u16 n64_read_physical_half(u32 address) {
 
 void n64_write_physical_byte(u32 address, u32 value) {
     logdebug("Writing 0x%02X to [0x%08X]", value & 0xFF, address);
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        invalidate_dynarec_ram(BYTE_ADDRESS(address));
+        page->ram[BYTE_ADDRESS(address & N64_BUS_PAGE_MASK)] = value;
+        return;
+    }
     invalidate_dynarec_page(BYTE_ADDRESS(address));
     switch (address) {
         case REGION_RDRAM:
@@ -705,6 +842,7 @@ void n64_write_physical_byte(u32 address, u32 value) {
         case REGION_RDRAM_REGS:
             logfatal("Writing byte 0x%02X to address 0x%08X in unsupported region: REGION_RDRAM_REGS", value & 0xFF, address);
         case REGION_SP_MEM:
+            rsp_thread_sync();
             value = value << (8 * (3 - (address & 3)));
             address = (address & 0xFFF) & ~3;
             if (address & 0x1000) {
@@ -759,12 +897,17 @@ void n64_write_physical_byte(u32 address, u32 value) {
 }
 
 u8 n64_read_physical_byte(u32 address) {
+    const n64_bus_page_t* page = &bus_pages[N64_BUS_PAGE_INDEX(address)];
+    if (likely(page->ram != NULL)) {
+        return page->ram[BYTE_ADDRESS(address & N64_BUS_PAGE_MASK)];
+    }
     switch (address) {
         case REGION_RDRAM:
             return n64sys.mem.rdram[BYTE_ADDRESS(address)];
         case REGION_RDRAM_REGS:
             logfatal("Reading byte from address 0x%08X in unsupported region: REGION_RDRAM_REGS", address);
         case REGION_SP_MEM:
+            rsp_thread_sync();
             if (address & 0x1000) {
                 return N64RSP.sp_imem[BYTE_ADDRESS(address) - SREGION_SP_IMEM];
             } else {
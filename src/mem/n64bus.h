@@ -185,6 +185,28 @@ INLINE u32 resolve_virtual_address_or_die(u64 virtual, bus_access_t bus_access)
     return physical;
 }
 
+// The physical address space is split into 1MiB pages, looked up in a table before falling back to the region switch.
+#define N64_BUS_PAGE_SHIFT 20
+#define N64_BUS_PAGE_SIZE (1 << N64_BUS_PAGE_SHIFT)
+#define N64_BUS_PAGE_MASK (N64_BUS_PAGE_SIZE - 1)
+#define N64_BUS_NUM_PAGES (1 << (32 - N64_BUS_PAGE_SHIFT))
+#define N64_BUS_PAGE_INDEX(address) ((address) >> N64_BUS_PAGE_SHIFT)
+
+typedef struct n64_bus_page {
+    // Host memory backing this page, accessed at any width with the *_ADDRESS() macros.
+    u8* ram;
+    // Host memory backing this page for word and dword reads only. Not used while the PI bus is latched.
+    u8* rom;
+    // Word handlers, used for pages not backed by host memory.
+    u32 (*read_word)(u32 address);
+    void (*write_word)(u32 address, u32 value);
+    // Accesses to this page have side effects, and it can never contain code.
+    bool mmio;
+} n64_bus_page_t;
+
+void n64_bus_init_pages();
+const n64_bus_page_t* n64_bus_get_page(u32 address);
+
 void n64_write_physical_dword(u32 address, u64 value);
 u64 n64_read_physical_dword(u32 address);
 
@@ -88,7 +88,8 @@ INLINE void assert_is_flash(n64_save_type_t save_type) {
 }
 
 typedef struct n64_mem {
-    u8 rdram[N64_RDRAM_SIZE];
+    // Page aligned so pages containing code can be write protected
+    u8 rdram[N64_RDRAM_SIZE] __attribute__((aligned(4096)));
     n64_rom_t rom;
     u32 rdram_reg[10];
     u32 pi_reg[13];
@@ -30,7 +30,7 @@ extern "C" {
 #endif
     void prdp_init_internal_swapchain();
     void prdp_update_screen();
-    void prdp_enqueue_command(int command_length, u32* buffer);
+    void prdp_enqueue_command(int command_length, const u32* buffer);
     void prdp_on_full_sync();
     void prdp_update_screen_no_game();
     bool prdp_is_framerate_unlocked();
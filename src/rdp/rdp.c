@@ -13,20 +13,22 @@
 
 #include "parallel_rdp_wrapper.h"
 #include "softrdp.h"
+#include "rdp_trace.h"
 #include <log.h>
 #include <frontend/render.h>
 #include <rsp.h>
+#include <system/rsp_thread.h>
 #include <frontend/frontend.h>
 
 static void* plugin_handle = NULL;
 static u32 rdram_size_word = N64_RDRAM_SIZE; // GFX_INFO needs this to be sent as a uint32
 
-#define RDP_COMMAND_BUFFER_SIZE 0xFFFFF
-u32 rdp_command_buffer[RDP_COMMAND_BUFFER_SIZE];
-
-#define FROM_RDRAM(address) word_from_byte_array(n64sys.mem.rdram, WORD_ADDRESS(address))
-#define FROM_DMEM(address) word_from_byte_array(N64RSP.sp_dmem, (address) & 0xFFF)
+// The longest command, a shaded, textured and z-buffered triangle
+#define RDP_MAX_COMMAND_WORDS 44
 
+// Command lists are parsed in place, only a command cut off at the end of a list is kept here until the rest arrives
+static u32 partial_command[RDP_MAX_COMMAND_WORDS];
+static int partial_command_words = 0;
 
 static const int command_lengths[64] = {
         2, 2, 2, 2, 2, 2, 2, 2, 8, 12, 24, 28, 24, 28, 40, 44,
@@ -63,6 +65,7 @@ void rdp_check_interrupts() {
 }
 
 void write_word_dpcreg(u32 address, u32 value) {
+    rsp_thread_sync();
     switch (address) {
         case ADDR_DPC_START_REG:
             rdp_start_reg_write(value);
@@ -94,6 +97,7 @@ void write_word_dpcreg(u32 address, u32 value) {
 }
 
 u32 read_word_dpcreg(u32 address) {
+    rsp_thread_sync();
     switch (address) {
         case ADDR_DPC_START_REG:
             return n64sys.dpc.start;
@@ -116,7 +120,7 @@ u32 read_word_dpcreg(u32 address) {
     }
 }
 
-INLINE void rdp_enqueue_command(int command_length, u32* buffer) {
+INLINE void rdp_enqueue_command(int command_length, const u32* buffer) {
     switch (n64sys.video_type) {
         case UNKNOWN_VIDEO_TYPE:
             logfatal("RDP enqueue command with video type UNKNOWN_VIDEO_TYPE");
@@ -124,7 +128,7 @@ INLINE void rdp_enqueue_command(int command_length, u32* buffer) {
         case QT_VULKAN_VIDEO_TYPE:
             prdp_enqueue_command(command_length, buffer); break;
         case SOFTWARE_VIDEO_TYPE:
-            softrdp_enqueue_command(&n64sys.softrdp_state, command_length, (uint64_t *) buffer); break;
+            softrdp_enqueue_command(&n64sys.softrdp_state, command_length, buffer); break;
     }
 }
 
@@ -136,7 +140,8 @@ INLINE void rdp_on_full_sync() {
         case QT_VULKAN_VIDEO_TYPE:
             prdp_on_full_sync(); break;
         case SOFTWARE_VIDEO_TYPE:
-            full_sync_softrdp();
+            softrdp_flush(&n64sys.softrdp_state);
+            rdp_trace_check_dump();
             break;
     }
     n64sys.dpc.status.pipe_busy = false;
@@ -145,9 +150,51 @@ INLINE void rdp_on_full_sync() {
     interrupt_raise(INTERRUPT_DP);
 }
 
-void process_rdp_list() {
-    static int last_run_unprocessed_words = 0;
+INLINE void rdp_run_command_words(int command_length, const u32* words) {
+    u8 command = (words[0] >> 24) & 0x3F;
+
+    // Don't need to process commands under 8
+    if (command >= 8) {
+        rdp_enqueue_command(command_length, words);
+    }
+
+    if (command == RDP_COMMAND_FULL_SYNC) {
+        rdp_on_full_sync();
+    }
+}
+
+// Runs every whole command in a contiguous run of command words, starting with the rest of any cut off command.
+INLINE void rdp_run_command_span(const u32* words, int length_words) {
+    if (partial_command_words > 0) {
+        int command_length = command_lengths[(partial_command[0] >> 24) & 0x3F];
+        int needed = command_length - partial_command_words;
+        int available = needed < length_words ? needed : length_words;
+        memcpy(&partial_command[partial_command_words], words, available * sizeof(u32));
+        partial_command_words += available;
+        words += available;
+        length_words -= available;
+        if (partial_command_words < command_length) {
+            return;
+        }
+        partial_command_words = 0;
+        rdp_run_command_words(command_length, partial_command);
+    }
 
+    int index = 0;
+    while (index < length_words) {
+        int command_length = command_lengths[(words[index] >> 24) & 0x3F];
+        if (index + command_length > length_words) {
+            // Save the rest of the list for the next run
+            partial_command_words = length_words - index;
+            memcpy(partial_command, &words[index], partial_command_words * sizeof(u32));
+            break;
+        }
+        rdp_run_command_words(command_length, &words[index]);
+        index += command_length;
+    }
+}
+
+void process_rdp_list() {
     n64_dpc_t* dpc = &n64sys.dpc;
 
     // tell the game to not touch RDP stuff while we work
@@ -165,75 +212,24 @@ void process_rdp_list() {
         return;
     }
 
-    if (display_list_length + (last_run_unprocessed_words * 4) > RDP_COMMAND_BUFFER_SIZE) {
-        logfatal("Got a command of display_list_length %d / 0x%X (with %d unprocessed words from last run) - this overflows our buffer of size %d / 0x%X!",
-                 display_list_length, display_list_length, last_run_unprocessed_words, RDP_COMMAND_BUFFER_SIZE, RDP_COMMAND_BUFFER_SIZE);
-    }
-
-    // read the commands into a buffer, 32 bits at a time.
-    // we need to read the whole thing into a buffer before sending each command to the RDP
-    // because commands have variable lengths
+    // Both RDRAM and DMEM hold words in host order, exactly what the backends take, so commands are run from where they are.
     if (dpc->status.xbus_dmem_dma) {
-        for (int i = 0; i < display_list_length; i += 4) {
-            u32 command_word = FROM_DMEM(current + i);
-            rdp_command_buffer[last_run_unprocessed_words + (i >> 2)] = command_word;
+        // DMEM wraps around, so the list is run in pieces that stop at the end of it
+        for (int offset = 0; offset < display_list_length;) {
+            u32 dmem_address = (current + offset) & (SP_DMEM_SIZE - 1);
+            int length = SP_DMEM_SIZE - dmem_address;
+            if (length > display_list_length - offset) {
+                length = display_list_length - offset;
+            }
+            rdp_run_command_span((const u32*)&N64RSP.sp_dmem[dmem_address], length >> 2);
+            offset += length;
         }
     } else {
-        if (end > 0x7FFFFFF || current > 0x7FFFFFF) {
+        if (end > N64_RDRAM_SIZE) {
             logwarn("Not running RDP commands, wanted to read past end of RDRAM!");
             return;
         }
-        for (int i = 0; i < display_list_length; i += 4) {
-            u32 command_word = FROM_RDRAM(current + i);
-            rdp_command_buffer[last_run_unprocessed_words + (i >> 2)] = command_word;
-        }
-    }
-
-    int length_words = (display_list_length >> 2) + last_run_unprocessed_words;
-    int buf_index = 0;
-
-    bool processed_all = true;
-
-    while (buf_index < length_words) {
-        u8 command = (rdp_command_buffer[buf_index] >> 24) & 0x3F;
-
-        int command_length = command_lengths[command];
-
-        // Check we actually have enough bytes left in the display list for this command, and save the remainder of the display list for the next run, if not.
-        if ((buf_index + command_length) * 4 > display_list_length + (last_run_unprocessed_words * 4)) {
-            // Copy remaining bytes back to the beginning of the display list, and save them for next run.
-            last_run_unprocessed_words = length_words - buf_index;
-
-            // Safe to allocate this on the stack because we'll only have a partial command left, and that _has_ to be pretty small.
-            u32 temp[last_run_unprocessed_words];
-            for (int i = 0; i < last_run_unprocessed_words; i++) {
-                temp[i] = rdp_command_buffer[buf_index + i];
-            }
-
-            for (int i = 0; i < last_run_unprocessed_words; i++) {
-                rdp_command_buffer[i] = temp[i];
-            }
-
-            processed_all = false;
-
-            break;
-        }
-
-
-        // Don't need to process commands under 8
-        if (command >= 8) {
-            rdp_enqueue_command(command_length, &rdp_command_buffer[buf_index]);
-        }
-
-        if (command == RDP_COMMAND_FULL_SYNC) {
-            rdp_on_full_sync();
-        }
-
-        buf_index += command_length;
-    }
-
-    if (processed_all) {
-        last_run_unprocessed_words = 0;
+        rdp_run_command_span((const u32*)&n64sys.mem.rdram[WORD_ADDRESS(current)], display_list_length >> 2);
     }
 
     dpc->current = end;
@@ -0,0 +1,75 @@
+#include "rdp_trace.h"
+
+#ifdef N64_RDP_TRACE
+#include <log.h>
+#include <signal.h>
+#include <stdlib.h>
+
+static rdp_trace_entry_t entries[RDP_TRACE_ENTRIES];
+static u32 next_sequence = 0;
+
+static const char* dump_path = NULL;
+static volatile sig_atomic_t dump_requested = false;
+
+void rdp_trace_init(const char* path) {
+    dump_path = path;
+    atexit(rdp_trace_dump);
+}
+
+void rdp_trace_record(rdp_trace_event_t event, u64 a, u64 b, u64 c) {
+    rdp_trace_entry_t* entry = &entries[next_sequence & (RDP_TRACE_ENTRIES - 1)];
+    entry->args[0] = a;
+    entry->args[1] = b;
+    entry->args[2] = c;
+    entry->sequence = next_sequence++;
+    entry->event = event;
+}
+
+void rdp_trace_request_dump() {
+    dump_requested = true;
+}
+
+void rdp_trace_check_dump() {
+    if (unlikely(dump_requested)) {
+        dump_requested = false;
+        rdp_trace_dump();
+    }
+}
+
+static void print_entry(FILE* f, const rdp_trace_entry_t* entry) {
+    const u64* args = entry->args;
+    switch (entry->event) {
+        case RDP_TRACE_COMMAND:
+            fprintf(f, "%10u command 0x%02" PRIX64 ": %016" PRIX64 " %016" PRIX64 "\n", entry->sequence, args[0], args[1], args[2]);
+            break;
+        case RDP_TRACE_EDGEWALK:
+            fprintf(f, "%10u edgewalk yh %d ym %d yl %d\n", entry->sequence, (int)args[0], (int)args[1], (int)args[2]);
+            break;
+        case RDP_TRACE_Z_COEFFICIENTS:
+            fprintf(f, "%10u z %08X dzdx %08X dzdy %08X\n", entry->sequence, (u32)args[0], (u32)args[1], (u32)args[2]);
+            break;
+        default:
+            fprintf(f, "%10u unknown event %u\n", entry->sequence, entry->event);
+            break;
+    }
+}
+
+void rdp_trace_dump() {
+    FILE* f = dump_path ? fopen(dump_path, "w") : stdout;
+    if (f == NULL) {
+        logwarn("Unable to open %s for the RDP trace", dump_path);
+        return;
+    }
+
+    // Oldest first. Until the buffer has wrapped, only the start of it has been written.
+    u32 count = next_sequence < RDP_TRACE_ENTRIES ? next_sequence : RDP_TRACE_ENTRIES;
+    for (u32 sequence = next_sequence - count; sequence != next_sequence; sequence++) {
+        print_entry(f, &entries[sequence & (RDP_TRACE_ENTRIES - 1)]);
+    }
+
+    if (f != stdout) {
+        fclose(f);
+        logalways("Wrote the last %u RDP trace entries to %s", count, dump_path);
+    }
+}
+#endif
@@ -0,0 +1,55 @@
+#ifndef N64_RDP_TRACE_H
+#define N64_RDP_TRACE_H
+
+#include <util.h>
+
+// Records what the software RDP does into a ring buffer of fixed size binary entries, instead of printing it as it
+// happens. Only formatted when dumped, on exit (including logfatal) or on SIGUSR1 at the next full sync.
+// Compiled in with N64_RDP_TRACE defined, or in debug builds like LOG_ENABLED. Otherwise rdp_trace() compiles to nothing.
+
+#ifdef N64_DEBUG_MODE
+#define N64_RDP_TRACE
+#endif
+
+// Must be a power of two
+#define RDP_TRACE_ENTRIES (1 << 14)
+
+typedef enum rdp_trace_event {
+    // Command id, first two command words
+    RDP_TRACE_COMMAND,
+    // yh, ym, yl in whole scanlines
+    RDP_TRACE_EDGEWALK,
+    // z, dzdx, dzdy as s15.16
+    RDP_TRACE_Z_COEFFICIENTS
+} rdp_trace_event_t;
+
+typedef struct rdp_trace_entry {
+    u64 args[3];
+    u32 sequence;
+    u32 event;
+} rdp_trace_entry_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef N64_RDP_TRACE
+void rdp_trace_init(const char* dump_path);
+// Only the thread executing RDP commands records, so entries don't need to be synchronized.
+void rdp_trace_record(rdp_trace_event_t event, u64 a, u64 b, u64 c);
+void rdp_trace_request_dump();
+void rdp_trace_check_dump();
+void rdp_trace_dump();
+#define rdp_trace(event, a, b, c) rdp_trace_record(event, a, b, c)
+#else
+#define rdp_trace_init(dump_path) do {} while(0)
+#define rdp_trace(event, a, b, c) do {} while(0)
+#define rdp_trace_request_dump() do {} while(0)
+#define rdp_trace_check_dump() do {} while(0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //N64_RDP_TRACE_H
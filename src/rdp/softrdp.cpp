@@ -3,12 +3,36 @@
 #include <cstring>
 #include <util.h>
 #include <mem/mem_util.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <memory>
 #include "softrdp.h"
+#include "rdp_trace.h"
+
+#ifdef N64_USE_SIMD
+#include <emmintrin.h>
+#endif
 
 #ifndef INLINE
 #define INLINE static inline __attribute__((always_inline))
 #endif
 
+#define SOFTRDP_RDRAM_MASK 0x7FFFFF
+
+// Scanlines are handed out to the workers in bands of 1 << SOFTRDP_BAND_SHIFT
+#define SOFTRDP_BAND_SHIFT 3
+// Queued primitives each hold on to a state snapshot, flush before there are too many of them
+#define SOFTRDP_MAX_QUEUED_PRIMITIVES 4096
+// The longest command, a shaded, textured and z-buffered triangle
+#define SOFTRDP_MAX_COMMAND_WORDS 22
+// Tiles addressing more texels than this are sampled straight from TMEM
+#define SOFTRDP_DECODED_TILE_TEXELS 0x4000
+// Bytes of commands the emulation thread can get ahead of the RDP thread by, must be a power of two
+#define SOFTRDP_RING_SIZE (1 << 20)
+
 #define EXEC_RDP_COMMAND(name) rdp_command_##name(rdp, command_length, buffer); break
 #define EXEC_RDP_COMMAND_TEMPLATE(name, tmpl) rdp_command_##name<tmpl>(rdp, command_length, buffer); break
 #define DEF_RDP_COMMAND(name) INLINE void rdp_command_##name(softrdp_state_t* rdp, int command_length, const uint64_t* buffer)
@@ -23,7 +47,7 @@ INLINE int get_bytes_per_line(int texel_size, int width) {
         case TEXEL_SIZE_4:  return width >> 1;
         case TEXEL_SIZE_8:  return width;
         case TEXEL_SIZE_16: return width << 1;
-        case TEXEL_SIZE_32: return width << 4;
+        case TEXEL_SIZE_32: return width << 2;
         default: logfatal("Unknown texel size: %d", texel_size);
     }
 }
@@ -34,6 +58,19 @@ const int PIXEL_FORMAT_COLOR_INDEX = 2;
 const int PIXEL_FORMAT_IA          = 3;
 const int PIXEL_FORMAT_I           = 4;
 
+const int CYCLE_TYPE_1CYCLE = 0;
+const int CYCLE_TYPE_2CYCLE = 1;
+const int CYCLE_TYPE_COPY   = 2;
+const int CYCLE_TYPE_FILL   = 3;
+
+// The band of scanlines the current thread rasterizes. Without workers, that's all of them.
+static thread_local int band_index = 0;
+static thread_local int band_count = 1;
+
+INLINE bool owns_row(int y) {
+    return band_count == 1 || ((y >> SOFTRDP_BAND_SHIFT) % band_count) == band_index;
+}
+
 typedef enum rdp_command {
     RDP_COMMAND_FILL_TRIANGLE = 0x08,
     RDP_COMMAND_FILL_ZBUFFER_TRIANGLE = 0x09,
@@ -249,14 +286,29 @@ static_assert(sizeof(texture_rectangle_t) == 2 * sizeof(u64), "Texture rectangle
 typedef struct span {
     int start;
     int end;
+    // X on the major edge in s15.16, where the attributes are given
+    int32_t major_x;
 } span_t;
 
+// Scissor coordinates only go up to 1023, so no primitive needs more scanlines than this
+#define SOFTRDP_MAX_SPANS 1024
+
 typedef struct spans {
+    // Scanline the triangle starts on, which can be above the first span when it's clipped
+    int top_y;
     int start_y;
     int num_spans;
-    span_t spans[1024];
+    span_t spans[SOFTRDP_MAX_SPANS];
 } spans_t;
 
+// Primitives only touch pixels in [x0, x1) and [y0, y1)
+typedef struct clip_rect {
+    int x0;
+    int x1;
+    int y0;
+    int y1;
+} clip_rect_t;
+
 constexpr bool get_bit(uint64_t cmd, int bit) {
     return (cmd >> bit) & 1;
 }
@@ -291,76 +343,90 @@ INLINE void get_zbuffer_coefficients(const uint64_t* buffer, z_coefficients_t* c
     coefficients->dzdy   = get_bits(buffer[1], 31, 16);
     coefficients->dzdy_f = get_bits(buffer[1], 15, 0);
 
-
-    logalways("Z coefficients: z: %d.%d, dzdx: %d.%d, dzde: %d.%d, dzdy: %d.%d",
-              coefficients->z, coefficients->z_f,
-              coefficients->dzdx, coefficients->dzdx_f,
-              coefficients->dzde, coefficients->dzde_f,
-              coefficients->dzdy, coefficients->dzdy_f);
+    // Every band sets up the same triangle, only one of them needs to say so
+    if (band_index == 0) {
+        rdp_trace(RDP_TRACE_Z_COEFFICIENTS,
+                  (u32)coefficients->z << 16 | coefficients->z_f,
+                  (u32)coefficients->dzdx << 16 | coefficients->dzdx_f,
+                  (u32)coefficients->dzdy << 16 | coefficients->dzdy_f);
+    }
 }
 
-INLINE void triangle_edgewalker(softrdp_state_t* rdp, const edge_coefficients_t* ec, spans_t* spans) {
-    uint32_t xstart;
-    uint32_t xend;
-
-    int32_t dxstart;
-    int32_t dxend;
+INLINE int32_t join_fixed(int16_t integer, uint16_t frac) {
+    return (int32_t)((uint32_t)(uint16_t)integer << 16 | frac);
+}
 
-    if (ec->right_major) {
-        xstart = ec->xm << 16 | ec->xm_f;
-        xend = ec->xh << 16 | ec->xh_f;
+// Edge Y coordinates are signed 11.2 in 14 bits, this gives the scanline they fall on.
+INLINE int edge_y(u64 y) {
+    return (int32_t)((uint32_t)y << 18) >> 20;
+}
 
-        dxstart = ec->dxmdy << 16 | ec->dxmdy_f;
-        dxend = ec->dxhdy << 16 | ec->dxhdy_f;
-    } else {
-        xstart = ec->xh << 16 | ec->xh_f;
-        xend = ec->xm << 16 | ec->xm_f;
+// Steps an edge in s15.16 down by some number of scanlines, wrapping like the hardware's adders would.
+INLINE int32_t step_edge(int32_t x, int32_t dxdy, int lines) {
+    return (int32_t)(uint32_t)((int64_t)x + (int64_t)dxdy * lines);
+}
 
-        dxstart = ec->dxhdy << 16 | ec->dxhdy_f;
-        dxend = ec->dxmdy << 16 | ec->dxmdy_f;
+// Scissor coordinates are in 10.2, an unset scissor only clips to the color image and the scanlines a triangle can have.
+INLINE void get_clip_rect(softrdp_state_t* rdp, clip_rect_t* clip) {
+    clip->x0 = 0;
+    clip->x1 = rdp->color_image.width;
+    clip->y0 = 0;
+    clip->y1 = SOFTRDP_MAX_SPANS;
+    if (rdp->scissor.xl != 0 || rdp->scissor.yl != 0) {
+        clip->x0 = rdp->scissor.xh >> 2;
+        clip->y0 = rdp->scissor.yh >> 2;
+        clip->x1 = (rdp->scissor.xl >> 2) < clip->x1 ? (rdp->scissor.xl >> 2) : clip->x1;
+        clip->y1 = rdp->scissor.yl >> 2;
     }
+}
 
-    int bytes_per_pixel = get_bytes_per_pixel(rdp);
-
-    int yh = ec->yh / 4;
-    int ym = ec->ym / 4;
-    int yl = ec->yl / 4;
-
-    logalways("Edgewalking triangle yh %d ym %d yl %d", yh, ym, yl);
-
-    spans->start_y = yh;
-
-    int span_index = 0;
-
-    for (int y = yh; y < ym; y += 1) {
-        span_t* s = &spans->spans[span_index++];
+// Walks the edges of a triangle, but only over the scanlines inside the clip rectangle.
+INLINE void triangle_edgewalker(const edge_coefficients_t* ec, const clip_rect_t* clip, spans_t* spans) {
+    const int yh = edge_y(ec->yh);
+    const int ym = edge_y(ec->ym);
+    const int yl = edge_y(ec->yl);
 
-        s->start = ((ec->right_major ? xend : xstart) >> 16);
-        s->end = ((ec->right_major ? xstart : xend) >> 16);
+    if (band_index == 0) {
+        rdp_trace(RDP_TRACE_EDGEWALK, yh, ym, yl);
+    }
 
-        xstart += dxstart;
-        xend += dxend;
+    int y = yh > clip->y0 ? yh : clip->y0;
+    int y_end = yl < clip->y1 ? yl : clip->y1;
+    if (y_end - y > SOFTRDP_MAX_SPANS) {
+        y_end = y + SOFTRDP_MAX_SPANS;
     }
 
-    if (ec->right_major) {
-        xstart = ec->xl << 16 | ec->xl_f;
-        dxstart = ec->dxldy << 16 | ec->dxldy_f;
+    spans->top_y = yh;
+    spans->start_y = y;
+    spans->num_spans = y_end > y ? y_end - y : 0;
+
+    // The major edge runs the whole height of the triangle, the minor edge switches from XM to XL at YM.
+    const int32_t dxhdy = join_fixed(ec->dxhdy, ec->dxhdy_f);
+    int32_t major = step_edge(join_fixed(ec->xh, ec->xh_f), dxhdy, y - yh);
+    int32_t minor;
+    int32_t dminor;
+    if (y < ym) {
+        dminor = join_fixed(ec->dxmdy, ec->dxmdy_f);
+        minor = step_edge(join_fixed(ec->xm, ec->xm_f), dminor, y - yh);
     } else {
-        xend = ec->xl << 16 | ec->xl_f;
-        dxend = ec->dxldy << 16 | ec->dxldy_f;
+        dminor = join_fixed(ec->dxldy, ec->dxldy_f);
+        minor = step_edge(join_fixed(ec->xl, ec->xl_f), dminor, y - ym);
     }
 
-    for (int y = ym; y < yl; y += 1) {
-        span_t* s = &spans->spans[span_index++];
+    for (int i = 0; i < spans->num_spans; i++, y++) {
+        if (y == ym) {
+            dminor = join_fixed(ec->dxldy, ec->dxldy_f);
+            minor = join_fixed(ec->xl, ec->xl_f);
+        }
 
-        s->start = ((ec->right_major ? xend : xstart) >> 16);
-        s->end = ((ec->right_major ? xstart : xend) >> 16);
+        span_t* s = &spans->spans[i];
+        s->start = major >> 16;
+        s->end = minor >> 16;
+        s->major_x = major;
 
-        xstart += dxstart;
-        xend += dxend;
+        major = step_edge(major, dxhdy, 1);
+        minor = step_edge(minor, dminor, 1);
     }
-
-    spans->num_spans = span_index;
 }
 
 INLINE blender_source_t from_1a(int value) {
@@ -376,7 +442,7 @@ INLINE blender_source_t from_1a(int value) {
 INLINE blender_source_t from_1b(int value) {
     switch(value) {
         case 0: return BLENDER_PIXEL_ALPHA;
-        case 1: return BLENDER_PRIMITIVE_ALPHA;
+        case 1: return BLENDER_FOG_ALPHA;
         case 2: return BLENDER_SHADE_ALPHA;
         case 3: return BLENDER_ZERO;
         default: logfatal("Unknown 1b blender source: %d", value);
@@ -403,69 +469,21 @@ INLINE blender_source_t from_2b(int value) {
     }
 }
 
-uint8_t get_blender_alpha(softrdp_state_t* rdp, blender_source_t source) {
-    switch (source) {
-        case BLENDER_PIXEL_ALPHA:
-            // TODO
-            return 0xFF;
-        case BLENDER_PRIMITIVE_ALPHA:
-            logfatal("BLENDER_PRIMITIVE_ALPHA");
-        case BLENDER_SHADE_ALPHA:
-            logfatal("BLENDER_SHADE_ALPHA");
-        case BLENDER_ONE_MINUS_ALPHA:
-            // TODO
-            return 0xFF;
-        case BLENDER_MEMORY_ALPHA:
-            logfatal("BLENDER_MEMORY_ALPHA");
-        case BLENDER_ONE:
-            logfatal("BLENDER_ONE");
-        case BLENDER_ZERO:
-            logfatal("BLENDER_ZERO");
-
-        case BLENDER_PIXEL_COLOR:
-        case BLENDER_MEMORY_COLOR:
-        case BLENDER_BLEND_COLOR:
-        case BLENDER_FOG_COLOR:
-            logfatal("Getting color value from get_blender_alpha function!");
-        default:
-            logfatal("get_blender_alpha(): unknown source!");
-    }
+INLINE uint8_t clamp_u8(int value) {
+    return value < 0 ? 0 : (value > 0xFF ? 0xFF : value);
 }
 
-color_32bpp_t get_blender_color(softrdp_state_t* rdp, blender_source_t source) {
-    switch(source) {
-        case BLENDER_PIXEL_COLOR:
-            // TODO: Output of color combiner
-            return {.raw = 0xFFFFFFFF };
-        case BLENDER_MEMORY_COLOR:
-            logfatal("BLENDER_MEMORY_COLOR");
-            break;
-        case BLENDER_BLEND_COLOR:
-            return rdp->blend_color;
-        case BLENDER_FOG_COLOR:
-            logfatal("BLENDER_FOG_COLOR");
-            break;
-        case BLENDER_PIXEL_ALPHA:
-        case BLENDER_PRIMITIVE_ALPHA:
-        case BLENDER_SHADE_ALPHA:
-        case BLENDER_ONE_MINUS_ALPHA:
-        case BLENDER_MEMORY_ALPHA:
-        case BLENDER_ONE:
-        case BLENDER_ZERO:
-            logfatal("Getting alpha value from get_blender_color function!");
-        default:
-            logfatal("get_blender_color(): unknown source!");
-    }
-}
-
-color_32bpp_t blender(softrdp_state_t* rdp, int cycle) {
-    color_32bpp_t _1a = get_blender_color(rdp, rdp->other_modes.blender_config[cycle].source_1a);
-    uint8_t _1b       = get_blender_alpha(rdp, rdp->other_modes.blender_config[cycle].source_1b);
-    color_32bpp_t _2a = get_blender_color(rdp, rdp->other_modes.blender_config[cycle].source_2a);
-    uint8_t _2b       = get_blender_alpha(rdp, rdp->other_modes.blender_config[cycle].source_2b);
-
-    // TODO: (1a * 1b + 2a * 2b) / (1b + 2b)
-    return _1a;
+// (1a * 1b + 2a * 2b), with both alphas cut to 5 bits like the hardware does
+INLINE color_32bpp_t blend_colors(color_32bpp_t _1a, uint8_t _1b, color_32bpp_t _2a, uint8_t _2b, uint8_t alpha) {
+    int a = _1b >> 3;
+    int b = (_2b >> 3) + 1;
+
+    color_32bpp_t result;
+    result.r = clamp_u8((_1a.r * a + _2a.r * b) >> 5);
+    result.g = clamp_u8((_1a.g * a + _2a.g * b) >> 5);
+    result.b = clamp_u8((_1a.b * a + _2a.b * b) >> 5);
+    result.a = alpha;
+    return result;
 }
 
 color_16bpp_t convert_32bpp_to_16bpp(color_32bpp_t color) {
@@ -483,42 +501,8 @@ uint32_t convert_32bpp_to_packed_16bpp(color_32bpp_t color) {
     return ((uint32_t)converted.raw << 16) | converted.raw;
 }
 
-INLINE uint16_t fill_for_addr(softrdp_state_t* rdp, uint32_t addr) {
-    uint32_t color = 0;
-    color_32bpp_t blender_color;
-    switch (rdp->other_modes.cycle_type) {
-        case 0: // 1-cycle mode: run entire pipeline
-
-            // color combiner: cycle 1 value
-            // blender: cycle 0 value
-
-            blender_color = blender(rdp, 0);
-            if (get_bytes_per_pixel(rdp) == 2) {
-                color = convert_32bpp_to_packed_16bpp(blender_color);
-            } else {
-                color = blender_color.raw;
-            }
-            break;
-        case 1: // 2-cycle mode: runs the pipeline twice
-            logfatal("2-cycle mode");
-            break;
-        case 2: // Copy mode: copies from TMEM to framebuffer
-            logfatal("Copy mode");
-            break;
-        case 3: // Fill mode: just runs the rasterizer
-            color = rdp->fill_color;
-            break;
-        default:
-            logfatal("fill_for_addr(): unknown cycle type %d", rdp->other_modes.cycle_type);
-    }
-
-    // Code below is optimized to remove the conditional.
-    // Essentially, the behavior is to use the upper bits of fill_color if we're on an even column,
-    // and the lower bits if we're on an odd column.
-
-    // return rdp->fill_color >> (addr % 4 == 0 ? 16 : 0);
-    return color >> (16 - ((addr % 4) * 8));
-}
+// Defined after the pixel pipeline, which it runs through
+INLINE uint32_t get_fill_pattern(softrdp_state_t* rdp);
 
 INLINE void rdram_write16(softrdp_state_t* rdp, u32 address, u16 value) {
     memcpy(&rdp->rdram[HALF_ADDRESS(address)], &value, sizeof(u16));
@@ -544,12 +528,72 @@ INLINE u32 rdram_read32(softrdp_state_t* rdp, u32 address) {
     return value;
 }
 
+// Fills [start, end) with the pattern. Both are byte addresses of 16 bit pixels, so they're always even.
+// RDRAM is stored as host order words, so a word aligned pattern is just the pattern itself: the upper half is the
+// pixel at the lower address. Only a head or tail half word needs splitting.
+INLINE void fill_span(softrdp_state_t* rdp, u32 start, u32 end, u32 pattern) {
+    if (start >= end) {
+        return;
+    }
+    if ((start & ~SOFTRDP_RDRAM_MASK) != 0 || ((end - 1) & ~SOFTRDP_RDRAM_MASK) != 0) {
+        // Wraps around the end of RDRAM, take the slow way
+        for (u32 addr = start; addr < end; addr += 2) {
+            rdram_write16(rdp, addr & SOFTRDP_RDRAM_MASK, (addr & 2) ? pattern : pattern >> 16);
+        }
+        return;
+    }
+
+    if (start & 2) {
+        rdram_write16(rdp, start, pattern);
+        start += 2;
+    }
+    if (end & 2) {
+        end -= 2;
+        rdram_write16(rdp, end, pattern >> 16);
+    }
+
+    u8* p = &rdp->rdram[WORD_ADDRESS(start)];
+    u8* p_end = p + (end - start);
+#ifdef N64_USE_SIMD
+    while (p < p_end && ((uintptr_t)p & 15) != 0) {
+        memcpy(p, &pattern, sizeof(u32));
+        p += sizeof(u32);
+    }
+    const __m128i fill = _mm_set1_epi32((int)pattern);
+    while (p_end - p >= 64) {
+        _mm_store_si128((__m128i*)(p +  0), fill);
+        _mm_store_si128((__m128i*)(p + 16), fill);
+        _mm_store_si128((__m128i*)(p + 32), fill);
+        _mm_store_si128((__m128i*)(p + 48), fill);
+        p += 64;
+    }
+    while (p_end - p >= 16) {
+        _mm_store_si128((__m128i*)p, fill);
+        p += 16;
+    }
+#else
+    const u64 fill = (u64)pattern << 32 | pattern;
+    while (p_end - p >= 8) {
+        memcpy(p, &fill, sizeof(u64));
+        p += sizeof(u64);
+    }
+#endif
+    while (p < p_end) {
+        memcpy(p, &pattern, sizeof(u32));
+        p += sizeof(u32);
+    }
+}
+
 INLINE u16 tmem_read16(softrdp_state_t* rdp, u16 address) {
     u16 value;
     memcpy(&value, &rdp->tmem[HALF_ADDRESS(address)], sizeof(u16));
     return value;
 }
 
+INLINE u8 tmem_read8(softrdp_state_t* rdp, u16 address) {
+    return rdp->tmem[BYTE_ADDRESS(address)];
+}
+
 INLINE void tmem_write8(softrdp_state_t* rdp, u16 address, u8 value) {
     rdp->tmem[BYTE_ADDRESS(address)] = value;
 }
@@ -560,71 +604,832 @@ INLINE void tmem_write16(softrdp_state_t* rdp, u16 address, u16 value) {
 
 void softrdp_init(softrdp_state_t* state, uint8_t* rdramptr) {
     state->rdram = rdramptr;
+    // Decoded texels start out stamped with 0, so they all start out stale
+    state->texture_generation = 1;
 }
 
-DEF_RDP_COMMAND(fill_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
+// Any change to TMEM, a tile descriptor or the TLUT mode makes every decoded texel stale.
+INLINE void invalidate_decoded_textures(softrdp_state_t* rdp) {
+    rdp->texture_generation++;
+}
+
+INLINE void fill_triangle_spans(softrdp_state_t* rdp, const edge_coefficients_t* ec) {
+    clip_rect_t clip;
+    get_clip_rect(rdp, &clip);
 
-    static spans_t spans;
-    triangle_edgewalker(rdp, ec, &spans);
+    static thread_local spans_t spans;
+    triangle_edgewalker(ec, &clip, &spans);
 
     int bytes_per_pixel = get_bytes_per_pixel(rdp);
+    const uint32_t pattern = get_fill_pattern(rdp);
 
     for (int i = 0; i < spans.num_spans; i++) {
         int y = spans.start_y + i;
+        if (!owns_row(y)) {
+            continue;
+        }
         span_t* s = &spans.spans[i];
 
         uint32_t yofs = rdp->color_image.dram_addr + y * rdp->color_image.width * bytes_per_pixel;
 
         int x_start = s->start < s->end ? s->start : s->end;
         int x_end = s->end > s->start ? s->end : s->start;
+        x_start = x_start < clip.x0 ? clip.x0 : x_start;
+        x_end = x_end > clip.x1 ? clip.x1 : x_end;
+        if (x_start >= x_end) {
+            continue;
+        }
+
+        fill_span(rdp, yofs + x_start * bytes_per_pixel, yofs + x_end * bytes_per_pixel, pattern);
+    }
+}
+
+typedef enum triangle_attribute {
+    ATTR_R,
+    ATTR_G,
+    ATTR_B,
+    ATTR_A,
+    ATTR_S,
+    ATTR_T,
+    ATTR_W,
+    ATTR_Z,
+    NUM_TRIANGLE_ATTRIBUTES
+} triangle_attribute_t;
+
+typedef struct triangle_attributes {
+    // All in s15.16. Values are at the top of the major edge.
+    int32_t value[NUM_TRIANGLE_ATTRIBUTES];
+    // Change per pixel along a span
+    int32_t dx[NUM_TRIANGLE_ATTRIBUTES];
+    // Change per scanline along the major edge
+    int32_t de[NUM_TRIANGLE_ATTRIBUTES];
+} triangle_attributes_t;
+
+typedef struct triangle_setup {
+    int tile;
+    int bytes_per_pixel;
+    clip_rect_t clip;
+} triangle_setup_t;
+
+// Shade and texture coefficients share a layout: four attributes per word, with the integer parts of the values,
+// DxDx, DxDe and DxDy in words 0, 1, 4 and 5, and their fractional parts in words 2, 3, 6 and 7.
+INLINE void get_attribute_coefficients(const uint64_t* buffer, triangle_attributes_t* attributes, int first, int count) {
+    for (int i = 0; i < count; i++) {
+        int hi = 63 - i * 16;
+        int lo = hi - 15;
+        attributes->value[first + i] = (int32_t)(get_bits(buffer[0], hi, lo) << 16 | get_bits(buffer[2], hi, lo));
+        attributes->dx[first + i]    = (int32_t)(get_bits(buffer[1], hi, lo) << 16 | get_bits(buffer[3], hi, lo));
+        attributes->de[first + i]    = (int32_t)(get_bits(buffer[4], hi, lo) << 16 | get_bits(buffer[6], hi, lo));
+    }
+}
+
+// Shade colors are 9 bits, the top one means the value under- or overflowed.
+INLINE uint8_t clamp_shade(int32_t value) {
+    int v = (value >> 16) & 0x1FF;
+    if (v & 0x100) {
+        return (v & 0x80) ? 0 : 0xFF;
+    }
+    return v;
+}
+
+INLINE color_32bpp_t gray(uint8_t value) {
+    color_32bpp_t color;
+    color.r = color.g = color.b = color.a = value;
+    return color;
+}
+
+INLINE color_32bpp_t unpack_16bpp(uint16_t raw) {
+    color_32bpp_t color;
+    color.r = ((raw >> 11) & 0x1F) << 3 | ((raw >> 13) & 0x7);
+    color.g = ((raw >>  6) & 0x1F) << 3 | ((raw >>  8) & 0x7);
+    color.b = ((raw >>  1) & 0x1F) << 3 | ((raw >>  3) & 0x7);
+    color.a = (raw & 1) ? 0xFF : 0;
+    return color;
+}
+
+INLINE color_32bpp_t unpack_ia16(uint16_t raw) {
+    color_32bpp_t color = gray(raw >> 8);
+    color.a = raw & 0xFF;
+    return color;
+}
 
-        for (int x = x_start * bytes_per_pixel; x < x_end * bytes_per_pixel; x += 2) {
-            uint32_t addr = yofs + x;
-            rdram_write16(rdp, addr, fill_for_addr(rdp, addr));
+INLINE color_32bpp_t tlut_lookup(softrdp_state_t* rdp, int index) {
+    // Each palette entry is repeated four times across the upper half of TMEM
+    uint16_t entry = tmem_read16(rdp, 0x800 + (index << 3));
+    return rdp->other_modes.tlut_type ? unpack_ia16(entry) : unpack_16bpp(entry);
+}
+
+// Texture coordinates come in as s10.5, texels go out as integer coordinates inside the tile.
+INLINE int texel_coordinate(int32_t coord, uint16_t tile_low, uint16_t tile_high, bool clamp, bool mirror, uint8_t mask, uint8_t shift) {
+    if (shift <= 10) {
+        coord >>= shift;
+    } else {
+        coord <<= (16 - shift);
+    }
+    coord -= tile_low << 3;
+    int texel = coord >> 5;
+
+    if (clamp || mask == 0) {
+        int max = (tile_high - tile_low) >> 2;
+        if (texel < 0 || max < 0) {
+            texel = 0;
+        } else if (texel > max) {
+            texel = max;
         }
     }
+
+    if (mask != 0) {
+        if (mirror && ((texel >> mask) & 1)) {
+            texel = ~texel;
+        }
+        texel &= (1 << mask) - 1;
+    }
+    return texel;
 }
 
-DEF_RDP_COMMAND(fill_zbuffer_triangle) {
+INLINE color_32bpp_t fetch_texel(softrdp_state_t* rdp, const softrdp_tile_t* tile, int s, int t) {
+    const u32 tmem_line = tile->tmem_adrs * sizeof(u64) + t * tile->line * sizeof(u64);
+    const u32 tmem_xor = (t & 1) << 2; // Xor the address by 4 for odd lines
+    const bool ci = tile->format == PIXEL_FORMAT_COLOR_INDEX && rdp->other_modes.en_tlut;
+
+    switch (tile->size) {
+        case TEXEL_SIZE_4: {
+            u8 byte = tmem_read8(rdp, ((tmem_line + (s >> 1)) ^ tmem_xor) & 0xFFF);
+            u8 nibble = (s & 1) ? byte & 0xF : byte >> 4;
+            if (ci) {
+                return tlut_lookup(rdp, tile->palette << 4 | nibble);
+            } else if (tile->format == PIXEL_FORMAT_IA) {
+                u8 i = nibble >> 1;
+                color_32bpp_t color = gray(i << 5 | i << 2 | i >> 1);
+                color.a = (nibble & 1) ? 0xFF : 0;
+                return color;
+            }
+            return gray(nibble * 0x11);
+        }
+        case TEXEL_SIZE_8: {
+            u8 byte = tmem_read8(rdp, ((tmem_line + s) ^ tmem_xor) & 0xFFF);
+            if (ci) {
+                return tlut_lookup(rdp, byte);
+            } else if (tile->format == PIXEL_FORMAT_IA) {
+                color_32bpp_t color = gray((byte >> 4) * 0x11);
+                color.a = (byte & 0xF) * 0x11;
+                return color;
+            }
+            return gray(byte);
+        }
+        case TEXEL_SIZE_16: {
+            u16 texel = tmem_read16(rdp, ((tmem_line + s * 2) ^ tmem_xor) & 0xFFF);
+            if (ci) {
+                return tlut_lookup(rdp, texel >> 8);
+            } else if (tile->format == PIXEL_FORMAT_IA) {
+                return unpack_ia16(texel);
+            }
+            return unpack_16bpp(texel);
+        }
+        case TEXEL_SIZE_32: {
+            // Red and green in the lower half of TMEM, blue and alpha at the same address in the upper half
+            const u16 tmem_addr = ((tmem_line + s * 2) & 0x7FF) ^ tmem_xor;
+            u16 rg = tmem_read16(rdp, tmem_addr);
+            u16 ba = tmem_read16(rdp, tmem_addr | 0x800);
+            color_32bpp_t color;
+            color.r = rg >> 8;
+            color.g = rg & 0xFF;
+            color.b = ba >> 8;
+            color.a = ba & 0xFF;
+            return color;
+        }
+        default:
+            logfatal("Unknown texel size: %d", tile->size);
+    }
+}
+
+typedef struct decoded_texel {
+    color_32bpp_t color;
+    // The texture generation this was decoded in
+    uint32_t generation;
+} decoded_texel_t;
+
+typedef struct decoded_tile {
+    // The texture generation width and height were worked out in
+    uint32_t generation;
+    // Every texel coordinate the tile can produce is inside these. 0 if there are too many to cache.
+    int width;
+    int height;
+    decoded_texel_t texels[SOFTRDP_DECODED_TILE_TEXELS];
+} decoded_tile_t;
+
+// Texels are decoded to RGBA8888 the first time they're sampled, then read back until the texture generation changes.
+// Every thread has its own, workers rasterize queued primitives from different snapshots of the state.
+static thread_local std::unique_ptr<decoded_tile_t[]> decoded_tiles;
+
+INLINE int decoded_tile_size(uint16_t tile_low, uint16_t tile_high, uint8_t mask) {
+    if (mask != 0) {
+        return 1 << mask;
+    }
+    int max = (tile_high - tile_low) >> 2;
+    return max < 0 ? 1 : max + 1;
+}
+
+INLINE decoded_tile_t* get_decoded_tile(softrdp_state_t* rdp, int tile_index) {
+    if (!decoded_tiles) {
+        decoded_tiles.reset(new decoded_tile_t[8]());
+    }
+
+    decoded_tile_t* decoded = &decoded_tiles[tile_index];
+    if (decoded->generation != rdp->texture_generation) {
+        const softrdp_tile_t* tile = &rdp->tiles[tile_index];
+        decoded->generation = rdp->texture_generation;
+        decoded->width = decoded_tile_size(tile->sl, tile->sh, tile->mask_s);
+        decoded->height = decoded_tile_size(tile->tl, tile->th, tile->mask_t);
+        if (decoded->width * decoded->height > SOFTRDP_DECODED_TILE_TEXELS) {
+            decoded->width = 0;
+            decoded->height = 0;
+        }
+    }
+    return decoded;
+}
+
+INLINE color_32bpp_t sample_texture(softrdp_state_t* rdp, int tile_index, int32_t s, int32_t t) {
+    tile_index &= 7;
+    const softrdp_tile_t* tile = &rdp->tiles[tile_index];
+    int texel_s = texel_coordinate(s, tile->sl, tile->sh, tile->cs, tile->ms, tile->mask_s, tile->shift_s);
+    int texel_t = texel_coordinate(t, tile->tl, tile->th, tile->ct, tile->mt, tile->mask_t, tile->shift_t);
+
+    decoded_tile_t* decoded = get_decoded_tile(rdp, tile_index);
+    if ((unsigned)texel_s >= (unsigned)decoded->width || (unsigned)texel_t >= (unsigned)decoded->height) {
+        return fetch_texel(rdp, tile, texel_s, texel_t);
+    }
+
+    decoded_texel_t* texel = &decoded->texels[texel_t * decoded->width + texel_s];
+    if (texel->generation != rdp->texture_generation) {
+        texel->color = fetch_texel(rdp, tile, texel_s, texel_t);
+        texel->generation = rdp->texture_generation;
+    }
+    return texel->color;
+}
+
+// Everything the combiner and blender muxes can select. A compiled pipeline holds indexes into this instead of mux
+// settings, so picking an input is a load rather than a switch. Alphas the RGB multiplier can select are broadcast.
+typedef enum pixel_slot {
+    // Change from pixel to pixel
+    SLOT_COMBINED,
+    SLOT_TEXEL0,
+    SLOT_TEXEL1,
+    SLOT_SHADE,
+    SLOT_COMBINED_ALPHA,
+    SLOT_TEXEL0_ALPHA,
+    SLOT_TEXEL1_ALPHA,
+    SLOT_SHADE_ALPHA,
+    // The combiner's output going into the first blender cycle, the first cycle's output going into the second
+    SLOT_BLENDER_PIXEL,
+    SLOT_MEMORY,
+
+    // Fixed for the whole primitive
+    SLOT_PRIM,
+    SLOT_ENV,
+    SLOT_PRIM_ALPHA,
+    SLOT_ENV_ALPHA,
+    SLOT_PRIM_LOD_FRAC,
+    SLOT_BLEND,
+    SLOT_FOG,
+    SLOT_ONE,
+    SLOT_HALF,
+    SLOT_ZERO,
+    NUM_PIXEL_SLOTS
+} pixel_slot_t;
+
+// Inputs in A - B, * C, + D order
+typedef struct combiner_cycle {
+    uint8_t rgb[4];
+    uint8_t alpha[4];
+} combiner_cycle_t;
+
+typedef struct blender_cycle {
+    uint8_t color_1a;
+    uint8_t alpha_1b;
+    uint8_t color_2a;
+    uint8_t alpha_2b;
+    bool one_minus_1b;
+} blender_cycle_t;
+
+// One set_combine and set_other_modes configuration, compiled
+typedef struct pixel_pipeline {
+    bool valid;
+    uint64_t combine_raw;
+    uint64_t other_modes_raw;
+
+    bool two_cycle;
+    bool force_blend;
+    combiner_cycle_t combiner[2];
+    blender_cycle_t blender[2];
+} pixel_pipeline_t;
+
+// Key, convert and LOD inputs aren't emulated yet and read as zero. Noise isn't either and reads as mid gray.
+INLINE uint8_t combiner_rgb_input_slot(int source) {
+    switch (source) {
+        case 0: return SLOT_COMBINED;
+        case 1: return SLOT_TEXEL0;
+        case 2: return SLOT_TEXEL1;
+        case 3: return SLOT_PRIM;
+        case 4: return SLOT_SHADE;
+        case 5: return SLOT_ENV;
+        default: return SLOT_ZERO;
+    }
+}
+
+INLINE uint8_t combiner_rgb_sub_a_slot(int source) {
+    switch (source) {
+        case 6: return SLOT_ONE;
+        case 7: return SLOT_HALF;
+        default: return combiner_rgb_input_slot(source);
+    }
+}
+
+INLINE uint8_t combiner_rgb_mul_slot(int source) {
+    switch (source) {
+        case 7:  return SLOT_COMBINED_ALPHA;
+        case 8:  return SLOT_TEXEL0_ALPHA;
+        case 9:  return SLOT_TEXEL1_ALPHA;
+        case 10: return SLOT_PRIM_ALPHA;
+        case 11: return SLOT_SHADE_ALPHA;
+        case 12: return SLOT_ENV_ALPHA;
+        case 14: return SLOT_PRIM_LOD_FRAC;
+        default: return combiner_rgb_input_slot(source);
+    }
+}
+
+INLINE uint8_t combiner_rgb_add_slot(int source) {
+    return source == 6 ? SLOT_ONE : combiner_rgb_input_slot(source);
+}
+
+INLINE uint8_t combiner_alpha_input_slot(int source) {
+    switch (source) {
+        case 0: return SLOT_COMBINED;
+        case 1: return SLOT_TEXEL0;
+        case 2: return SLOT_TEXEL1;
+        case 3: return SLOT_PRIM;
+        case 4: return SLOT_SHADE;
+        case 5: return SLOT_ENV;
+        case 6: return SLOT_ONE;
+        default: return SLOT_ZERO;
+    }
+}
+
+INLINE uint8_t combiner_alpha_mul_slot(int source) {
+    switch (source) {
+        case 0: return SLOT_ZERO;
+        case 6: return SLOT_PRIM_LOD_FRAC;
+        case 7: return SLOT_ZERO;
+        default: return combiner_alpha_input_slot(source);
+    }
+}
+
+INLINE uint8_t blender_color_slot(blender_source_t source) {
+    switch (source) {
+        case BLENDER_PIXEL_COLOR:  return SLOT_BLENDER_PIXEL;
+        case BLENDER_MEMORY_COLOR: return SLOT_MEMORY;
+        case BLENDER_BLEND_COLOR:  return SLOT_BLEND;
+        case BLENDER_FOG_COLOR:    return SLOT_FOG;
+        default: logfatal("blender_color_slot(): %d is not a color source", source);
+    }
+}
+
+INLINE uint8_t blender_alpha_slot(blender_source_t source) {
+    switch (source) {
+        case BLENDER_PIXEL_ALPHA:  return SLOT_BLENDER_PIXEL;
+        case BLENDER_FOG_ALPHA:    return SLOT_FOG;
+        case BLENDER_SHADE_ALPHA:  return SLOT_SHADE;
+        case BLENDER_MEMORY_ALPHA: return SLOT_MEMORY;
+        case BLENDER_ONE:          return SLOT_ONE;
+        case BLENDER_ZERO:         return SLOT_ZERO;
+        // Not a slot, the blender works it out from 1b
+        case BLENDER_ONE_MINUS_ALPHA: return SLOT_ZERO;
+        // Only before the first set_other_modes, when every source is still zero
+        default: return SLOT_ZERO;
+    }
+}
+
+static void compile_pixel_pipeline(softrdp_state_t* rdp, pixel_pipeline_t* pipeline) {
+    const auto& c = rdp->combine;
+    pipeline->valid = true;
+    pipeline->combine_raw = rdp->combine_raw;
+    pipeline->other_modes_raw = rdp->other_modes_raw;
+    pipeline->two_cycle = rdp->other_modes.cycle_type == CYCLE_TYPE_2CYCLE;
+    pipeline->force_blend = rdp->other_modes.force_blend;
+
+    const uint8_t sub_a_R[2] = {c.sub_a_R_0, c.sub_a_R_1};
+    const uint8_t sub_b_R[2] = {c.sub_b_R_0, c.sub_b_R_1};
+    const uint8_t mul_R[2]   = {c.mul_R_0,   c.mul_R_1};
+    const uint8_t add_R[2]   = {c.add_R_0,   c.add_R_1};
+    const uint8_t sub_a_A[2] = {c.sub_a_A_0, c.sub_a_A_1};
+    const uint8_t sub_b_A[2] = {c.sub_b_A_0, c.sub_b_A_1};
+    const uint8_t mul_A[2]   = {c.mul_A_0,   c.mul_A_1};
+    const uint8_t add_A[2]   = {c.add_A_0,   c.add_A_1};
+
+    for (int cycle = 0; cycle < 2; cycle++) {
+        combiner_cycle_t* cc = &pipeline->combiner[cycle];
+        cc->rgb[0] = combiner_rgb_sub_a_slot(sub_a_R[cycle]);
+        cc->rgb[1] = combiner_rgb_input_slot(sub_b_R[cycle]);
+        cc->rgb[2] = combiner_rgb_mul_slot(mul_R[cycle]);
+        cc->rgb[3] = combiner_rgb_add_slot(add_R[cycle]);
+        cc->alpha[0] = combiner_alpha_input_slot(sub_a_A[cycle]);
+        cc->alpha[1] = combiner_alpha_input_slot(sub_b_A[cycle]);
+        cc->alpha[2] = combiner_alpha_mul_slot(mul_A[cycle]);
+        cc->alpha[3] = combiner_alpha_input_slot(add_A[cycle]);
+
+        const blender_config_t* config = &rdp->other_modes.blender_config[cycle];
+        blender_cycle_t* bc = &pipeline->blender[cycle];
+        bc->color_1a = blender_color_slot(config->source_1a);
+        bc->alpha_1b = blender_alpha_slot(config->source_1b);
+        bc->color_2a = blender_color_slot(config->source_2a);
+        bc->alpha_2b = blender_alpha_slot(config->source_2b);
+        bc->one_minus_1b = config->source_2b == BLENDER_ONE_MINUS_ALPHA;
+    }
+}
+
+#define PIXEL_PIPELINE_CACHE_SIZE 64
+
+// Compiled pipelines, looked up by a hash of the raw set_combine and set_other_modes words.
+// Every thread has its own so the lookup doesn't need a lock.
+INLINE const pixel_pipeline_t* get_pixel_pipeline(softrdp_state_t* rdp) {
+    static thread_local pixel_pipeline_t cache[PIXEL_PIPELINE_CACHE_SIZE];
+
+    const uint64_t hash = (rdp->combine_raw ^ (rdp->other_modes_raw * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull;
+    pixel_pipeline_t* pipeline = &cache[hash >> 58];
+    if (!pipeline->valid || pipeline->combine_raw != rdp->combine_raw || pipeline->other_modes_raw != rdp->other_modes_raw) {
+        compile_pixel_pipeline(rdp, pipeline);
+    }
+    return pipeline;
+}
+
+// (A - B) * C + D
+INLINE uint8_t combine_channel(int a, int b, int c, int d) {
+    return clamp_u8(((a - b) * c + (d << 8) + 0x80) >> 8);
+}
+
+INLINE color_32bpp_t combine(const color_32bpp_t* slots, const combiner_cycle_t* cycle) {
+    const color_32bpp_t sub_a = slots[cycle->rgb[0]];
+    const color_32bpp_t sub_b = slots[cycle->rgb[1]];
+    const color_32bpp_t mul   = slots[cycle->rgb[2]];
+    const color_32bpp_t add   = slots[cycle->rgb[3]];
+
+    color_32bpp_t result;
+    result.r = combine_channel(sub_a.r, sub_b.r, mul.r, add.r);
+    result.g = combine_channel(sub_a.g, sub_b.g, mul.g, add.g);
+    result.b = combine_channel(sub_a.b, sub_b.b, mul.b, add.b);
+    result.a = combine_channel(slots[cycle->alpha[0]].a, slots[cycle->alpha[1]].a, slots[cycle->alpha[2]].a, slots[cycle->alpha[3]].a);
+    return result;
+}
+
+template<bool force_blend>
+INLINE color_32bpp_t blend(const color_32bpp_t* slots, const blender_cycle_t* cycle) {
+    const color_32bpp_t _1a = slots[cycle->color_1a];
+    // Coverage isn't tracked, so without force_blend there's never an edge pixel to blend and 1a passes through.
+    if constexpr (!force_blend) {
+        return _1a;
+    }
+    const uint8_t _1b = slots[cycle->alpha_1b].a;
+    const uint8_t _2b = cycle->one_minus_1b ? ~_1b : slots[cycle->alpha_2b].a;
+    return blend_colors(_1a, _1b, slots[cycle->color_2a], _2b, slots[SLOT_BLENDER_PIXEL].a);
+}
+
+INLINE color_32bpp_t broadcast_alpha(color_32bpp_t color) {
+    color_32bpp_t result;
+    result.raw = color.a * 0x01010101u;
+    return result;
+}
+
+// Zeroes the slots that change from pixel to pixel and fills in the ones fixed for the whole primitive
+INLINE void fill_constant_slots(softrdp_state_t* rdp, color_32bpp_t* slots) {
+    for (int i = 0; i < NUM_PIXEL_SLOTS; i++) {
+        slots[i] = gray(0);
+    }
+    slots[SLOT_PRIM] = rdp->prim_color;
+    slots[SLOT_ENV] = rdp->env_color;
+    slots[SLOT_PRIM_ALPHA] = broadcast_alpha(rdp->prim_color);
+    slots[SLOT_ENV_ALPHA] = broadcast_alpha(rdp->env_color);
+    slots[SLOT_PRIM_LOD_FRAC] = gray(rdp->prim_lod_frac);
+    slots[SLOT_BLEND] = rdp->blend_color;
+    slots[SLOT_FOG] = rdp->fog_color;
+    slots[SLOT_ONE] = gray(0xFF);
+    slots[SLOT_HALF] = gray(0x80);
+}
+
+// The value fill primitives write, repeated every 32 bits: two 16 bit pixels, or one 32 bit pixel.
+// Nothing in it depends on the position, so it's worked out once per primitive.
+INLINE uint32_t get_fill_pattern(softrdp_state_t* rdp) {
+    uint32_t color = 0;
+    color_32bpp_t blender_color;
+    switch (rdp->other_modes.cycle_type) {
+        case 0: { // 1-cycle mode: run entire pipeline
+
+            // color combiner: cycle 1 value
+            // blender: cycle 0 value
+
+            color_32bpp_t slots[NUM_PIXEL_SLOTS];
+            fill_constant_slots(rdp, slots);
+            slots[SLOT_BLENDER_PIXEL].raw = 0xFFFFFFFF;
+            slots[SLOT_MEMORY].raw = 0;
+            slots[SLOT_SHADE].raw = 0xFFFFFFFF;
+            const pixel_pipeline_t* pipeline = get_pixel_pipeline(rdp);
+            blender_color = pipeline->force_blend ? blend<true>(slots, &pipeline->blender[0]) : blend<false>(slots, &pipeline->blender[0]);
+            if (get_bytes_per_pixel(rdp) == 2) {
+                color = convert_32bpp_to_packed_16bpp(blender_color);
+            } else {
+                color = blender_color.raw;
+            }
+            break;
+        }
+        case 1: // 2-cycle mode: runs the pipeline twice
+            logfatal("2-cycle mode");
+            break;
+        case 2: // Copy mode: copies from TMEM to framebuffer
+            logfatal("Copy mode");
+            break;
+        case 3: // Fill mode: just runs the rasterizer
+            color = rdp->fill_color;
+            break;
+        default:
+            logfatal("get_fill_pattern(): unknown cycle type %d", rdp->other_modes.cycle_type);
+    }
+    return color;
+}
+
+// Depth is 18 bits, stored as a 3 bit exponent counting the leading ones and an 11 bit mantissa, above 2 bits of dz.
+INLINE uint32_t z_decompress(uint16_t stored) {
+    int exponent = (stored >> 13) & 7;
+    uint32_t mantissa = (stored >> 2) & 0x7FF;
+    uint32_t base = 0x40000 - (0x40000 >> exponent);
+    int shift = exponent < 6 ? 6 - exponent : 0;
+    return base + (mantissa << shift);
+}
+
+INLINE uint16_t z_compress(uint32_t z) {
+    int exponent = 0;
+    while (exponent < 7 && (z & (0x20000 >> exponent))) {
+        exponent++;
+    }
+    int shift = exponent < 6 ? 6 - exponent : 0;
+    uint32_t mantissa = (z >> shift) & 0x7FF;
+    return (exponent << 13) | (mantissa << 2);
+}
+
+INLINE color_32bpp_t read_framebuffer(softrdp_state_t* rdp, u32 address, int bytes_per_pixel) {
+    if (bytes_per_pixel == 2) {
+        color_32bpp_t color = unpack_16bpp(rdram_read16(rdp, address));
+        // The low bit is coverage rather than alpha
+        color.a = color.a ? 0xE0 : 0;
+        return color;
+    }
+    color_32bpp_t color;
+    color.raw = rdram_read32(rdp, address);
+    return color;
+}
+
+INLINE void write_framebuffer(softrdp_state_t* rdp, u32 address, int bytes_per_pixel, color_32bpp_t color) {
+    if (bytes_per_pixel == 2) {
+        rdram_write16(rdp, address, convert_32bpp_to_16bpp(color).raw);
+    } else {
+        rdram_write32(rdp, address, color.raw);
+    }
+}
+
+// Runs one pixel through texturing, the combiner, depth test, blender and out to memory.
+// values holds the interpolated attributes of four pixels, this one is in the given lane.
+template<bool shade, bool texture, bool zbuffer, bool two_cycle, bool force_blend>
+INLINE void shade_pixel(softrdp_state_t* rdp, const triangle_setup_t* setup, const pixel_pipeline_t* pipeline, color_32bpp_t* slots,
+                        int x, int y, const int32_t values[NUM_TRIANGLE_ATTRIBUTES][4], int lane) {
+    const u32 pixel_index = y * rdp->color_image.width + x;
+
+    u32 z = 0;
+    u32 z_address = 0;
+    if constexpr (zbuffer) {
+        if (rdp->other_modes.z_source_sel) {
+            z = (rdp->primitive_z & 0x7FFF) << 3;
+        } else {
+            int32_t pixel_z = values[ATTR_Z][lane] >> 13;
+            z = pixel_z < 0 ? 0 : (pixel_z > 0x3FFFF ? 0x3FFFF : pixel_z);
+        }
+        z_address = (rdp->z_image + pixel_index * 2) & SOFTRDP_RDRAM_MASK;
+        if (rdp->other_modes.z_compare_en && z >= z_decompress(rdram_read16(rdp, z_address))) {
+            return;
+        }
+    }
+
+    if constexpr (shade) {
+        color_32bpp_t* shade_color = &slots[SLOT_SHADE];
+        shade_color->r = clamp_shade(values[ATTR_R][lane]);
+        shade_color->g = clamp_shade(values[ATTR_G][lane]);
+        shade_color->b = clamp_shade(values[ATTR_B][lane]);
+        shade_color->a = clamp_shade(values[ATTR_A][lane]);
+        slots[SLOT_SHADE_ALPHA] = broadcast_alpha(*shade_color);
+    }
+
+    if constexpr (texture) {
+        int32_t s = values[ATTR_S][lane];
+        int32_t t = values[ATTR_T][lane];
+        int32_t w = values[ATTR_W][lane];
+        if (rdp->other_modes.persp_tex_en && w > 0) {
+            s = (int32_t)(((int64_t)s << 15) / w);
+            t = (int32_t)(((int64_t)t << 15) / w);
+        } else {
+            s >>= 16;
+            t >>= 16;
+        }
+        slots[SLOT_TEXEL0] = sample_texture(rdp, setup->tile, s, t);
+        slots[SLOT_TEXEL1] = two_cycle ? sample_texture(rdp, setup->tile + 1, s, t) : slots[SLOT_TEXEL0];
+        slots[SLOT_TEXEL0_ALPHA] = broadcast_alpha(slots[SLOT_TEXEL0]);
+        slots[SLOT_TEXEL1_ALPHA] = broadcast_alpha(slots[SLOT_TEXEL1]);
+    }
+
+    if constexpr (two_cycle) {
+        // The first cycle has no combined input yet
+        slots[SLOT_COMBINED] = gray(0);
+        slots[SLOT_COMBINED_ALPHA] = gray(0);
+        slots[SLOT_COMBINED] = combine(slots, &pipeline->combiner[0]);
+        slots[SLOT_COMBINED_ALPHA] = broadcast_alpha(slots[SLOT_COMBINED]);
+    }
+    // 1-cycle mode uses the second cycle's combiner settings
+    color_32bpp_t color = combine(slots, &pipeline->combiner[1]);
+
+    if (rdp->other_modes.alpha_compare_en && color.a < rdp->blend_color.a) {
+        return;
+    }
+
+    const u32 address = (rdp->color_image.dram_addr + pixel_index * setup->bytes_per_pixel) & SOFTRDP_RDRAM_MASK;
+
+    slots[SLOT_BLENDER_PIXEL] = color;
+    if (rdp->other_modes.image_read_en) {
+        slots[SLOT_MEMORY] = read_framebuffer(rdp, address, setup->bytes_per_pixel);
+    }
+    color = blend<force_blend>(slots, &pipeline->blender[0]);
+    if constexpr (two_cycle) {
+        slots[SLOT_BLENDER_PIXEL] = color;
+        color = blend<force_blend>(slots, &pipeline->blender[1]);
+    }
+
+    write_framebuffer(rdp, address, setup->bytes_per_pixel, color);
+
+    if constexpr (zbuffer) {
+        if (rdp->other_modes.z_update_en) {
+            rdram_write16(rdp, z_address, z_compress(z));
+        }
+    }
+}
+
+typedef void (*span_function_t)(softrdp_state_t* rdp, const triangle_setup_t* setup, const spans_t* spans,
+                                const triangle_attributes_t* attributes, const pixel_pipeline_t* pipeline);
+
+// One of these is instantiated for every primitive type and pipeline shape, the muxes inside are resolved by the pipeline.
+template<bool shade, bool texture, bool zbuffer, bool two_cycle, bool force_blend>
+static void rasterize_spans(softrdp_state_t* rdp, const triangle_setup_t* setup, const spans_t* spans,
+                            const triangle_attributes_t* attributes, const pixel_pipeline_t* pipeline) {
+    alignas(16) int32_t values[NUM_TRIANGLE_ATTRIBUTES][4];
+
+    // Anything the primitive doesn't have, or that doesn't change from pixel to pixel, is filled in once up front
+    color_32bpp_t slots[NUM_PIXEL_SLOTS];
+    fill_constant_slots(rdp, slots);
+
+    for (int i = 0; i < spans->num_spans; i++) {
+        int y = spans->start_y + i;
+        if (!owns_row(y)) {
+            continue;
+        }
+
+        const span_t* s = &spans->spans[i];
+        int x_start = s->start < s->end ? s->start : s->end;
+        int x_end = s->end > s->start ? s->end : s->start;
+        x_start = x_start < setup->clip.x0 ? setup->clip.x0 : x_start;
+        x_end = x_end > setup->clip.x1 ? setup->clip.x1 : x_end;
+        if (x_start >= x_end) {
+            continue;
+        }
+
+        // Step down the major edge to this scanline, then across to the first pixel
+        const int64_t offset = ((int64_t)x_start << 16) - s->major_x;
+        int32_t start[NUM_TRIANGLE_ATTRIBUTES];
+        for (int a = 0; a < NUM_TRIANGLE_ATTRIBUTES; a++) {
+            start[a] = (int32_t)(attributes->value[a] + (int64_t)attributes->de[a] * i + (((int64_t)attributes->dx[a] * offset) >> 16));
+        }
+
+#ifdef N64_USE_SIMD
+        // Interpolate four pixels at a time, then shade them one by one.
+        __m128i current[NUM_TRIANGLE_ATTRIBUTES];
+        __m128i step[NUM_TRIANGLE_ATTRIBUTES];
+        for (int a = 0; a < NUM_TRIANGLE_ATTRIBUTES; a++) {
+            const int32_t dx = attributes->dx[a];
+            current[a] = _mm_setr_epi32(start[a], start[a] + dx, start[a] + dx * 2, start[a] + dx * 3);
+            step[a] = _mm_set1_epi32(dx * 4);
+        }
+
+        for (int x = x_start; x < x_end; x += 4) {
+            for (int a = 0; a < NUM_TRIANGLE_ATTRIBUTES; a++) {
+                _mm_store_si128((__m128i*)values[a], current[a]);
+                current[a] = _mm_add_epi32(current[a], step[a]);
+            }
+            const int lanes = x_end - x < 4 ? x_end - x : 4;
+            for (int lane = 0; lane < lanes; lane++) {
+                shade_pixel<shade, texture, zbuffer, two_cycle, force_blend>(rdp, setup, pipeline, slots, x + lane, y, values, lane);
+            }
+        }
+#else
+        for (int x = x_start; x < x_end; x++) {
+            for (int a = 0; a < NUM_TRIANGLE_ATTRIBUTES; a++) {
+                values[a][0] = start[a];
+                start[a] += attributes->dx[a];
+            }
+            shade_pixel<shade, texture, zbuffer, two_cycle, force_blend>(rdp, setup, pipeline, slots, x, y, values, 0);
+        }
+#endif
+    }
+}
+
+template<bool shade, bool texture, bool zbuffer>
+INLINE span_function_t get_span_function(const pixel_pipeline_t* pipeline) {
+    static constexpr span_function_t functions[2][2] = {
+        { rasterize_spans<shade, texture, zbuffer, false, false>, rasterize_spans<shade, texture, zbuffer, false, true> },
+        { rasterize_spans<shade, texture, zbuffer, true,  false>, rasterize_spans<shade, texture, zbuffer, true,  true> },
+    };
+    return functions[pipeline->two_cycle][pipeline->force_blend];
+}
+
+// The coefficient blocks follow the edge coefficients in this order, each only when the command has them.
+template<bool shade, bool texture, bool zbuffer>
+INLINE void draw_triangle(softrdp_state_t* rdp, const uint64_t* buffer) {
     const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
 
-    static z_coefficients_t zc;
-    get_zbuffer_coefficients(&buffer[4], &zc);
+    if (rdp->other_modes.cycle_type == CYCLE_TYPE_FILL) {
+        fill_triangle_spans(rdp, ec);
+        return;
+    }
+
+    triangle_attributes_t attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    int word = 4;
+    if constexpr (shade) {
+        get_attribute_coefficients(&buffer[word], &attributes, ATTR_R, 4);
+        word += 8;
+    }
+    if constexpr (texture) {
+        get_attribute_coefficients(&buffer[word], &attributes, ATTR_S, 3);
+        word += 8;
+    }
+    if constexpr (zbuffer) {
+        z_coefficients_t zc;
+        get_zbuffer_coefficients(&buffer[word], &zc);
+        attributes.value[ATTR_Z] = join_fixed(zc.z, zc.z_f);
+        attributes.dx[ATTR_Z]    = join_fixed(zc.dzdx, zc.dzdx_f);
+        attributes.de[ATTR_Z]    = join_fixed(zc.dzde, zc.dzde_f);
+    }
+
+    triangle_setup_t setup;
+    setup.tile = ec->tile;
+    setup.bytes_per_pixel = get_bytes_per_pixel(rdp);
+    get_clip_rect(rdp, &setup.clip);
 
-    static spans_t spans;
-    triangle_edgewalker(rdp, ec, &spans);
-    logfatal("fill_zbuffer_triangle unimplemented");
+    static thread_local spans_t spans;
+    triangle_edgewalker(ec, &setup.clip, &spans);
+
+    // The attributes are given at the top of the triangle, move them down to the first scanline that's drawn
+    const int skipped = spans.start_y - spans.top_y;
+    for (int a = 0; a < NUM_TRIANGLE_ATTRIBUTES; a++) {
+        attributes.value[a] = (int32_t)(attributes.value[a] + (int64_t)attributes.de[a] * skipped);
+    }
+
+    const pixel_pipeline_t* pipeline = get_pixel_pipeline(rdp);
+    get_span_function<shade, texture, zbuffer>(pipeline)(rdp, &setup, &spans, &attributes, pipeline);
+}
+
+DEF_RDP_COMMAND(fill_triangle) {
+    draw_triangle<false, false, false>(rdp, buffer);
+}
+
+DEF_RDP_COMMAND(fill_zbuffer_triangle) {
+    draw_triangle<false, false, true>(rdp, buffer);
 }
 
 DEF_RDP_COMMAND(texture_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
-    logfatal("texture_triangle unimplemented");
+    draw_triangle<false, true, false>(rdp, buffer);
 }
 
 DEF_RDP_COMMAND(texture_zbuffer_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
-    logfatal("texture_zbuffer_triangle unimplemented");
+    draw_triangle<false, true, true>(rdp, buffer);
 }
 
 DEF_RDP_COMMAND(shade_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
-    logfatal("shade_triangle unimplemented");
+    draw_triangle<true, false, false>(rdp, buffer);
 }
 
 DEF_RDP_COMMAND(shade_zbuffer_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
-    logfatal("shade_zbuffer_triangle unimplemented");
+    draw_triangle<true, false, true>(rdp, buffer);
 }
 
 DEF_RDP_COMMAND(shade_texture_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
-    logfatal("shade_texture_triangle unimplemented");
+    draw_triangle<true, true, false>(rdp, buffer);
 }
 
 DEF_RDP_COMMAND(shade_texture_zbuffer_triangle) {
-    const auto* ec = reinterpret_cast<const edge_coefficients_t*>(buffer);
-    logfatal("shade_texture_zbuffer_triangle unimplemented");
+    draw_triangle<true, true, true>(rdp, buffer);
 }
 
 INLINE fixed_point_16<11, 5> process_st(fixed_point_16<11, 5> val, bool clamp_enable, bool mirror_enable, u16 mask, u16 shift) {
@@ -665,6 +1470,129 @@ INLINE fixed_point_16<11, 5> process_st(fixed_point_16<11, 5> val, bool clamp_en
     return val;
 }
 
+INLINE void copy_texel16(softrdp_state_t* rdp, u32 dst, u32 src, u32 tmem_xor, bool alpha_compare) {
+    u16 texel = tmem_read16(rdp, src ^ tmem_xor);
+    if (!alpha_compare || (texel & 1)) {
+        rdram_write16(rdp, dst, texel);
+    }
+}
+
+INLINE void copy_word(softrdp_state_t* rdp, u32 dst, u32 src, u32 tmem_xor, bool alpha_compare) {
+    if (alpha_compare) {
+        copy_texel16(rdp, dst, src, tmem_xor, alpha_compare);
+        copy_texel16(rdp, dst + 2, src + 2, tmem_xor, alpha_compare);
+    } else {
+        memcpy(&rdp->rdram[WORD_ADDRESS(dst)], &rdp->tmem[WORD_ADDRESS(src ^ tmem_xor)], sizeof(u32));
+    }
+}
+
+// Copies a row of 16 bit texels from TMEM straight to the framebuffer. Both are stored as host order words, so once
+// the addresses are word aligned, whole words can be moved as they are. Odd lines in TMEM have their words swapped
+// within each 64 bit block. In copy mode, alpha compare throws away texels with the low (alpha) bit clear.
+INLINE void copy_tmem_row16(softrdp_state_t* rdp, u32 dst, u32 src, int count, u32 tmem_xor, bool alpha_compare) {
+    if ((dst & 2) != (src & 2)) {
+        // Pixels and texels fall in different halves of their words, go one by one
+        for (int i = 0; i < count; i++) {
+            copy_texel16(rdp, dst + i * 2, src + i * 2, tmem_xor, alpha_compare);
+        }
+        return;
+    }
+
+    if ((dst & 2) && count > 0) {
+        copy_texel16(rdp, dst, src, tmem_xor, alpha_compare);
+        dst += 2;
+        src += 2;
+        count--;
+    }
+
+#ifdef N64_USE_SIMD
+    // Get TMEM to 64 bit alignment so the odd line swap stays inside each 128 bit block
+    if ((src & 4) && count >= 2) {
+        copy_word(rdp, dst, src, tmem_xor, alpha_compare);
+        dst += 4;
+        src += 4;
+        count -= 2;
+    }
+
+    const __m128i alpha_bit = _mm_set1_epi16(1);
+    while (count >= 8) {
+        __m128i texels = _mm_loadu_si128((const __m128i*)&rdp->tmem[WORD_ADDRESS(src)]);
+        if (tmem_xor) {
+            texels = _mm_shuffle_epi32(texels, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        __m128i* out = (__m128i*)&rdp->rdram[WORD_ADDRESS(dst)];
+        if (alpha_compare) {
+            const __m128i pass = _mm_cmpeq_epi16(_mm_and_si128(texels, alpha_bit), alpha_bit);
+            const __m128i pixels = _mm_loadu_si128(out);
+            texels = _mm_or_si128(_mm_and_si128(pass, texels), _mm_andnot_si128(pass, pixels));
+        }
+        _mm_storeu_si128(out, texels);
+        dst += 16;
+        src += 16;
+        count -= 8;
+    }
+#endif
+
+    while (count >= 2) {
+        copy_word(rdp, dst, src, tmem_xor, alpha_compare);
+        dst += 4;
+        src += 4;
+        count -= 2;
+    }
+
+    if (count > 0) {
+        copy_texel16(rdp, dst, src, tmem_xor, alpha_compare);
+    }
+}
+
+// Copy mode with one texel per pixel and nothing to wrap or mirror along S: 2D backgrounds, HUDs and blits.
+template<bool flip>
+INLINE bool can_copy_rows(softrdp_state_t* rdp, const texture_rectangle_t* cmd, const softrdp_tile_t* descriptor, int width) {
+    if (flip || rdp->other_modes.cycle_type != CYCLE_TYPE_COPY || descriptor->size != TEXEL_SIZE_16) {
+        return false;
+    }
+    // Copy mode steps four texels per pixel
+    if (cmd->dsdx.raw != (4 << 10) || cmd->s.frac != 0 || descriptor->shift_s != 0) {
+        return false;
+    }
+    const int s = cmd->s.integer;
+    if (s < 0 || width <= 0) {
+        return false;
+    }
+    if (descriptor->mask_s != 0 && s + width > (1 << descriptor->mask_s)) {
+        return false;
+    }
+    return true;
+}
+
+INLINE void copy_texture_rectangle(softrdp_state_t* rdp, const texture_rectangle_t* cmd, const softrdp_tile_t* descriptor, int xh, int yh, int xl, int yl) {
+    const u32 tmem_base = descriptor->tmem_adrs * sizeof(u64);
+    const u32 bytes_per_tile_line = descriptor->line * sizeof(u64);
+    const u32 bytes_per_screen_line = rdp->color_image.width * 2;
+    const int width = xl - xh;
+    const bool alpha_compare = rdp->other_modes.alpha_compare_en;
+
+    auto t = cmd->t;
+    for (int y = yh; y < yl; y++, t += cmd->dtdy) {
+        if (!owns_row(y)) {
+            continue;
+        }
+        const auto processed_t = process_st(t, descriptor->ct, descriptor->mt, descriptor->mask_t, descriptor->shift_t);
+        const u32 tmem_xor = (processed_t.integer & 1) << 2;
+        const u32 src = (tmem_base + processed_t.integer * bytes_per_tile_line + cmd->s.integer * 2) & 0x7FF;
+        const u32 dst = rdp->color_image.dram_addr + y * bytes_per_screen_line + xh * 2;
+
+        if (src + width * 2 <= 0x800 && dst + width * 2 <= SOFTRDP_RDRAM_MASK + 1) {
+            copy_tmem_row16(rdp, dst, src, width, tmem_xor, alpha_compare);
+        } else {
+            // Wraps around the end of TMEM or RDRAM
+            for (int x = 0; x < width; x++) {
+                copy_texel16(rdp, (dst + x * 2) & SOFTRDP_RDRAM_MASK, (src + x * 2) & 0x7FF, tmem_xor, alpha_compare);
+            }
+        }
+    }
+}
+
 template<bool flip>
 DEF_RDP_COMMAND(texture_rectangle) {
     const auto* cmd = reinterpret_cast<const texture_rectangle_t*>(buffer);
@@ -679,15 +1607,17 @@ DEF_RDP_COMMAND(texture_rectangle) {
 
     int xh = cmd->xh >> 2;
     int yh = cmd->yh >> 2;
-    logalways("Texture rectangle%s (%d, %d) (%d, %d) with tile %d starting at s,t %d.%d, %d.%d.", flip ? " flip" : "", xh, yh, xl, yl, cmd->tile, cmd->s.integer, cmd->s.frac, cmd->t.integer, cmd->t.frac);
-    logalways("dsdx: %s%d.%d", cmd->dsdx.integer < 0 ? "-" : "", cmd->dsdx.integer, cmd->dsdx.frac);
-    logalways("dtdy: %s%d.%d", cmd->dtdy.integer < 0 ? "-" : "", cmd->dtdy.integer, cmd->dtdy.frac);
+
+    if (can_copy_rows<flip>(rdp, cmd, descriptor, xl - xh)) {
+        copy_texture_rectangle(rdp, cmd, descriptor, xh, yh, xl, yl);
+        return;
+    }
 
     const auto orig_s = cmd->s;
     const auto orig_t = cmd->t;
 
     auto dsdx = cmd->dsdx;
-    if (rdp->other_modes.cycle_type == 2) {
+    if (rdp->other_modes.cycle_type == CYCLE_TYPE_COPY) {
         // Copy mode copies 4 texels at a time
         // This is a hack to simulate it
         dsdx.raw >>= 2;
@@ -700,11 +1630,18 @@ DEF_RDP_COMMAND(texture_rectangle) {
     u32 bytes_per_screen_line = rdp->color_image.width * bytes_per_pixel;
     u32 bytes_per_tile_line = descriptor->line * sizeof(u64);
 
+    // Same as the fast path above, copy mode drops texels with the alpha bit clear when alpha compare is on
+    const bool copy_alpha_compare = rdp->other_modes.cycle_type == CYCLE_TYPE_COPY && rdp->other_modes.alpha_compare_en;
+
     auto s = orig_s;
     auto t = orig_t;
     switch (descriptor->size) {
         case TEXEL_SIZE_16:
             for (int y = yh; y < yl; y++) {
+                if (!owns_row(y)) {
+                    t += dtdy;
+                    continue;
+                }
                 u32 screen_line = rdp->color_image.dram_addr + y * bytes_per_screen_line;
                 for (int x = xh; x < xl; x++) {
                     // TODO: for non-flipped rects, this can go in the body of the outer loop, before this inner loop
@@ -717,7 +1654,9 @@ DEF_RDP_COMMAND(texture_rectangle) {
                     const auto processed_s = process_st(flip ? t : s, descriptor->cs, descriptor->ms, descriptor->mask_s, descriptor->shift_s);
                     const u16 tmem_addr = ((tmem_line + processed_s.integer * 2) & 0X7FF) ^ tmem_xor;
                     u16 pixel = tmem_read16(rdp, tmem_addr);
-                    rdram_write16(rdp, screen_line + x * bytes_per_pixel, pixel);
+                    if (!copy_alpha_compare || (pixel & 1)) {
+                        rdram_write16(rdp, screen_line + x * bytes_per_pixel, pixel);
+                    }
 
                     s += dsdx;
                 }
@@ -727,6 +1666,10 @@ DEF_RDP_COMMAND(texture_rectangle) {
             break;
         case TEXEL_SIZE_32:
             for (int y = yh; y < yl; y++) {
+                if (!owns_row(y)) {
+                    t += dtdy;
+                    continue;
+                }
                 u32 screen_line = rdp->color_image.dram_addr + y * bytes_per_screen_line;
                 for (int x = xh; x < xl; x++) {
                     // TODO: for non-flipped rects, this can go in the body of the outer loop, before this inner loop
@@ -804,14 +1747,20 @@ DEF_RDP_COMMAND(set_prim_depth) {
 }
 
 DEF_RDP_COMMAND(set_other_modes) {
+    rdp->other_modes_raw = buffer[0];
     rdp->other_modes.atomic_prim      = get_bit(buffer[0], 55);
     rdp->other_modes.cycle_type       = get_bits(buffer[0], 53, 52);
     rdp->other_modes.persp_tex_en     = get_bit(buffer[0], 51);
     rdp->other_modes.detail_tex_en    = get_bit(buffer[0], 50);
     rdp->other_modes.sharpen_tex_en   = get_bit(buffer[0], 49);
     rdp->other_modes.tex_lod_en       = get_bit(buffer[0], 48);
-    rdp->other_modes.en_tlut          = get_bit(buffer[0], 47);
-    rdp->other_modes.tlut_type        = get_bit(buffer[0], 46);
+    const bool en_tlut = get_bit(buffer[0], 47);
+    const bool tlut_type = get_bit(buffer[0], 46);
+    if (en_tlut != rdp->other_modes.en_tlut || tlut_type != rdp->other_modes.tlut_type) {
+        invalidate_decoded_textures(rdp);
+    }
+    rdp->other_modes.en_tlut          = en_tlut;
+    rdp->other_modes.tlut_type        = tlut_type;
     rdp->other_modes.sample_type      = get_bit(buffer[0], 45);
     rdp->other_modes.mid_texel        = get_bit(buffer[0], 44);
     rdp->other_modes.bi_lerp_0        = get_bit(buffer[0], 43);
@@ -850,15 +1799,135 @@ DEF_RDP_COMMAND(set_other_modes) {
     rdp->other_modes.alpha_compare_en = get_bit(buffer[0], 0);
 }
 
+// Copies bytes from RDRAM to TMEM, xoring TMEM addresses with tmem_xor (4 on odd lines) and wrapping them with tmem_mask.
+// Both are stored as host order words, so when the two addresses line up within a word, whole words move as they are.
+INLINE void copy_to_tmem(softrdp_state_t* rdp, u32 tmem_addr, u32 dram_addr, int bytes, u32 tmem_xor, u32 tmem_mask) {
+    tmem_addr &= tmem_mask;
+    const bool aligned = ((tmem_addr ^ dram_addr) & 3) == 0;
+    const bool wraps = tmem_addr + bytes > tmem_mask + 1 || dram_addr + bytes > SOFTRDP_RDRAM_MASK + 1;
+    if (!aligned || wraps) {
+        for (int i = 0; i < bytes; i++) {
+            tmem_write8(rdp, ((tmem_addr + i) ^ tmem_xor) & tmem_mask, rdram_read8(rdp, (dram_addr + i) & SOFTRDP_RDRAM_MASK));
+        }
+        return;
+    }
+
+    while ((tmem_addr & 3) && bytes > 0) {
+        tmem_write8(rdp, tmem_addr ^ tmem_xor, rdram_read8(rdp, dram_addr));
+        tmem_addr++;
+        dram_addr++;
+        bytes--;
+    }
+
+#ifdef N64_USE_SIMD
+    // Get TMEM to 64 bit alignment so the odd line swap stays inside each 128 bit block
+    if ((tmem_addr & 4) && bytes >= 4) {
+        memcpy(&rdp->tmem[WORD_ADDRESS(tmem_addr ^ tmem_xor)], &rdp->rdram[WORD_ADDRESS(dram_addr)], sizeof(u32));
+        tmem_addr += 4;
+        dram_addr += 4;
+        bytes -= 4;
+    }
+    while (bytes >= 16) {
+        __m128i words = _mm_loadu_si128((const __m128i*)&rdp->rdram[WORD_ADDRESS(dram_addr)]);
+        if (tmem_xor) {
+            words = _mm_shuffle_epi32(words, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        _mm_storeu_si128((__m128i*)&rdp->tmem[WORD_ADDRESS(tmem_addr)], words);
+        tmem_addr += 16;
+        dram_addr += 16;
+        bytes -= 16;
+    }
+#endif
+
+    while (bytes >= 4) {
+        memcpy(&rdp->tmem[WORD_ADDRESS(tmem_addr ^ tmem_xor)], &rdp->rdram[WORD_ADDRESS(dram_addr)], sizeof(u32));
+        tmem_addr += 4;
+        dram_addr += 4;
+        bytes -= 4;
+    }
+
+    while (bytes > 0) {
+        tmem_write8(rdp, tmem_addr ^ tmem_xor, rdram_read8(rdp, dram_addr));
+        tmem_addr++;
+        dram_addr++;
+        bytes--;
+    }
+}
+
+INLINE void copy_texel32_to_tmem(softrdp_state_t* rdp, u32 tmem_addr, u32 texel) {
+    tmem_write16(rdp, tmem_addr | 0x000, texel >> 16); // RG component goes to lower half of TMEM
+    tmem_write16(rdp, tmem_addr | 0x800, texel);       // BA component goes to upper half of TMEM
+}
+
+// Copies 32 bit texels from RDRAM to TMEM, splitting them into RG in the lower half and BA in the upper half.
+// tmem_addr is where the first texel's RG goes, and has to be 64 bit aligned like every TMEM line is.
+INLINE void copy_to_tmem_split32(softrdp_state_t* rdp, u32 tmem_addr, u32 dram_addr, int texels, u32 tmem_xor) {
+    tmem_addr &= 0x7FF;
+    int s = 0;
+
+#ifdef N64_USE_SIMD
+    if ((dram_addr & 3) == 0 && (tmem_addr & 7) == 0 && dram_addr + texels * 4 <= SOFTRDP_RDRAM_MASK + 1) {
+        // Eight texels make 16 bytes of RG and 16 bytes of BA. In host order, the TMEM word holding texels n and n + 1
+        // has n in its upper half, so texels are swapped in pairs before packing the halves together.
+        for (; s + 8 <= texels && tmem_addr + s * 2 + 16 <= 0x800; s += 8) {
+            __m128i lo = _mm_loadu_si128((const __m128i*)&rdp->rdram[WORD_ADDRESS(dram_addr + s * 4)]);
+            __m128i hi = _mm_loadu_si128((const __m128i*)&rdp->rdram[WORD_ADDRESS(dram_addr + s * 4 + 16)]);
+            lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1));
+            hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1));
+            // Sign extending keeps packs from saturating
+            __m128i rg = _mm_packs_epi32(_mm_srai_epi32(lo, 16), _mm_srai_epi32(hi, 16));
+            __m128i ba = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16), _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+            if (tmem_xor) {
+                rg = _mm_shuffle_epi32(rg, _MM_SHUFFLE(2, 3, 0, 1));
+                ba = _mm_shuffle_epi32(ba, _MM_SHUFFLE(2, 3, 0, 1));
+            }
+            const u32 tmem_texel_address = tmem_addr + s * 2;
+            _mm_storeu_si128((__m128i*)&rdp->tmem[WORD_ADDRESS(tmem_texel_address | 0x000)], rg);
+            _mm_storeu_si128((__m128i*)&rdp->tmem[WORD_ADDRESS(tmem_texel_address | 0x800)], ba);
+        }
+    }
+#endif
+
+    for (; s < texels; s++) {
+        u32 texel = rdram_read32(rdp, (dram_addr + s * 4) & SOFTRDP_RDRAM_MASK);
+        copy_texel32_to_tmem(rdp, ((tmem_addr + s * 2) ^ tmem_xor) & 0x7FF, texel);
+    }
+}
+
 DEF_RDP_COMMAND(load_tlut) {
-    logfatal("load_tlut unimplemented");
+    invalidate_decoded_textures(rdp);
+    int tile_index = get_bits(buffer[0], 26, 24);
+    const softrdp_tile_t* descriptor = &rdp->tiles[tile_index];
+    unimplemented(rdp->texture_image.size != TEXEL_SIZE_16, "load tlut: texture image size %d isn't 16bpp", rdp->texture_image.size);
+
+    // Ignore fractional parts, palettes are a row of whole entries
+    const u16 sl = get_bits(buffer[0], 55, 44) >> 2;
+    const u16 tl = get_bits(buffer[0], 43, 32) >> 2;
+    const u16 sh = get_bits(buffer[0], 23, 12) >> 2;
+
+    const u32 tmem_base = descriptor->tmem_adrs * sizeof(u64); // tmem address in descriptor is in multiples of 64 bits
+    const u32 dram_line = rdp->texture_image.dram_addr + get_bytes_per_line(TEXEL_SIZE_16, rdp->texture_image.width) * tl + sl * 2;
+
+    // Each entry is written four times over, filling a whole 64 bit TMEM word. All four halves being the same,
+    // the word looks the same in host order.
+    for (int i = 0; i <= sh - sl; i++) {
+        u64 entry = rdram_read16(rdp, (dram_line + i * 2) & SOFTRDP_RDRAM_MASK);
+        u64 quadrupled = entry * 0x0001000100010001ull;
+        memcpy(&rdp->tmem[(tmem_base + i * sizeof(u64)) & 0xFF8], &quadrupled, sizeof(u64));
+    }
 }
 
 DEF_RDP_COMMAND(set_tile_size) {
-    logfatal("set_tile_size unimplemented");
+    invalidate_decoded_textures(rdp);
+    softrdp_tile_t* descriptor = &rdp->tiles[get_bits(buffer[0], 26, 24)];
+    descriptor->sl = get_bits(buffer[0], 55, 44);
+    descriptor->tl = get_bits(buffer[0], 43, 32);
+    descriptor->sh = get_bits(buffer[0], 23, 12);
+    descriptor->th = get_bits(buffer[0], 11, 0);
 }
 
 DEF_RDP_COMMAND(load_block) {
+    invalidate_decoded_textures(rdp);
     const auto* cmd = reinterpret_cast<const load_block_t*>(buffer);
     softrdp_tile_t* descriptor = &rdp->tiles[cmd->tile];
 
@@ -872,33 +1941,38 @@ DEF_RDP_COMMAND(load_block) {
     switch (rdp->texture_image.size) {
         case TEXEL_SIZE_16: {
             const int bytes_per_texel = 2;
-            int tmem_xor = 0;
-            for (unsigned i = 0; i <= (cmd->sh - cmd->sl); i++) {
-                int s = i + cmd->sl;
-                if ((i * bytes_per_texel) % 8 == 0) {
-                    // inc T by DxT
-                    t += dxt;
-                    tmem_xor = t.integer & 1 ? 4 : 0;
+            const int bytes = (cmd->sh - cmd->sl + 1) * bytes_per_texel;
+            const u32 start = cmd->sl * bytes_per_texel;
+            // T steps by DxT every 64 bit word, and odd T values get their words swapped. Words are copied a run at a
+            // time, for as long as T stays on lines of the same parity.
+            for (int i = 0; i < bytes;) {
+                t += dxt;
+                const u32 tmem_xor = t.integer & 1 ? 4 : 0;
+                int run_end = i + 8;
+                while (run_end < bytes) {
+                    auto next_t = t;
+                    next_t += dxt;
+                    if ((next_t.integer & 1) != (t.integer & 1)) {
+                        break;
+                    }
+                    t = next_t;
+                    run_end += 8;
                 }
-                u32 dram_texel_address = dram_base + s * bytes_per_texel;
-                u16 texel = rdram_read16(rdp, dram_texel_address);
-
-                u16 tmem_texel_address = tmem_base + (s * bytes_per_texel);
-                tmem_texel_address ^= tmem_xor; // For odd lines
-                tmem_texel_address &= 0XFFF;
-
-                tmem_write16(rdp, tmem_texel_address, texel);
+                if (run_end > bytes) {
+                    run_end = bytes;
+                }
+                copy_to_tmem(rdp, tmem_base + start + i, dram_base + start + i, run_end - i, tmem_xor, 0xFFF);
+                i = run_end;
             }
             break;
         }
         default:
             logfatal("Load block: unknown texel size: %d", rdp->texture_image.size);
     }
-
-    logalways("Load block: dxt: %d, sh: %d, tile: %d, tl: %d, sl: %d\n", cmd->dxt, cmd->sh, cmd->tile, cmd->tl, cmd->sl);
 }
 
 DEF_RDP_COMMAND(load_tile) {
+    invalidate_decoded_textures(rdp);
     int tile_index = get_bits(buffer[0], 26, 24);
     softrdp_tile_t* descriptor = &rdp->tiles[tile_index];
 
@@ -906,6 +1980,12 @@ DEF_RDP_COMMAND(load_tile) {
     unimplemented(descriptor->size != rdp->texture_image.size, "load tile: descriptor size %d != texture image size %d", descriptor->size, rdp->texture_image.size);
     //unimplemented(descriptor->format != rdp->texture_image.format, "load tile: descriptor format (%d) != texture image format (%d)", descriptor->format, rdp->texture_image.format);
 
+    // Loading a tile also sets its size
+    descriptor->sl = get_bits(buffer[0], 55, 44);
+    descriptor->tl = get_bits(buffer[0], 43, 32);
+    descriptor->sh = get_bits(buffer[0], 23, 12);
+    descriptor->th = get_bits(buffer[0], 11, 0);
+
     // Ignore fractional parts for now (TODO)
     const u16 sl = get_bits(buffer[0], 55, 44) >> 2;
     const u16 tl = get_bits(buffer[0], 43, 32) >> 2;
@@ -920,7 +2000,6 @@ DEF_RDP_COMMAND(load_tile) {
 
     unimplemented(tmem_base != 0, "load_tile not to start of tmem");
 
-    int bytes_copied = 0;
     switch (rdp->texture_image.size) {
         case TEXEL_SIZE_4:
             logfatal("Load tile: texel size 4bpp");
@@ -928,17 +2007,8 @@ DEF_RDP_COMMAND(load_tile) {
             for (int t = 0; t <= (th - tl); t++) {
                 const u32 tile_line = tmem_base + bytes_per_tile_line * t;
                 const u32 dram_line = dram_base + bytes_per_texture_line * (t + tl) + sl;
-                const u32 tmem_xor = t & 1 ? 4 : 0;
-                for (int s = 0; s <= (sh - sl); s++) {
-                    u32 dram_texel_address = dram_line + s;
-                    u8 texel = rdram_read8(rdp, dram_texel_address);
-
-                    u16 tmem_texel_address = tile_line + s;
-                    tmem_texel_address ^= tmem_xor; // For odd lines
-                    tmem_texel_address &= 0XFFF; // Safety
-
-                    tmem_write8(rdp, tmem_texel_address, texel);
-                }
+                const u32 tmem_xor = t & 1 ? 4 : 0; // For odd lines
+                copy_to_tmem(rdp, tile_line, dram_line, sh - sl + 1, tmem_xor, 0xFFF);
             }
             break;
         case TEXEL_SIZE_16: {
@@ -947,17 +2017,9 @@ DEF_RDP_COMMAND(load_tile) {
             for (int t = 0; t <= (th - tl); t++) {
                 const u32 tile_line = tmem_base + bytes_per_tile_line * t;
                 const u32 dram_line = dram_base + bytes_per_texture_line * (t + tl) + sl * bytes_per_texel;
-                const u32 tmem_xor = t & 1 ? 4 : 0;
-                for (int s = 0; s <= (sh - sl); s++) {
-                    u32 dram_texel_address = dram_line + s * bytes_per_texel;
-                    u16 texel = rdram_read16(rdp, dram_texel_address);
-
-                    u16 tmem_texel_address = tile_line + (s * 2);
-                    tmem_texel_address ^= tmem_xor; // For odd lines
-                    tmem_texel_address &= 0X7FF; // Mask to lower half of TMEM
-
-                    tmem_write16(rdp, tmem_texel_address, texel);
-                }
+                const u32 tmem_xor = t & 1 ? 4 : 0; // For odd lines
+                // Masked to the lower half of TMEM
+                copy_to_tmem(rdp, tile_line, dram_line, (sh - sl + 1) * bytes_per_texel, tmem_xor, 0x7FF);
             }
             break;
         }
@@ -970,21 +2032,7 @@ DEF_RDP_COMMAND(load_tile) {
 
                 // For odd lines: xor the tmem index with 4
                 const u32 tmem_xor = t & 1 ? 4 : 0;
-
-                for (int s = 0; s <= (sh - sl); s++) {
-                    u32 dram_texel_address = dram_line + s * bytes_per_texel;
-                    u32 texel = rdram_read32(rdp, dram_texel_address);
-
-                    u16 tmem_texel_address = tile_line + (s * 2);
-                    tmem_texel_address ^= tmem_xor; // For odd lines
-                    tmem_texel_address &= 0X7FF; // Mask to lower half of TMEM
-
-                    u16 rg = (texel >> 16) & 0xFFFF;
-                    u16 ba = (texel >>  0) & 0xFFFF;
-
-                    tmem_write16(rdp, tmem_texel_address | 0x000, rg); // RG component goes to lower half of TMEM
-                    tmem_write16(rdp, tmem_texel_address | 0x800, ba); // BA component goes to upper half of TMEM
-                }
+                copy_to_tmem_split32(rdp, tile_line, dram_line, sh - sl + 1, tmem_xor);
             }
 
             break;
@@ -992,11 +2040,10 @@ DEF_RDP_COMMAND(load_tile) {
         default:
             logfatal("Load tile: Unknown texel size: %d", rdp->texture_image.size);
     }
-
-    logalways("rdp_load_tile: copied %d bytes.", bytes_copied);
 }
 
 DEF_RDP_COMMAND(set_tile) {
+    invalidate_decoded_textures(rdp);
     int tile_index = get_bits(buffer[0], 26, 24);
     rdp->tiles[tile_index].format    = get_bits(buffer[0], 55, 53);
     rdp->tiles[tile_index].size      = get_bits(buffer[0], 52, 51);
@@ -1011,21 +2058,6 @@ DEF_RDP_COMMAND(set_tile) {
     rdp->tiles[tile_index].ms        = get_bit(buffer[0], 8);
     rdp->tiles[tile_index].mask_s    = get_bits(buffer[0], 7, 4);
     rdp->tiles[tile_index].shift_s   = get_bits(buffer[0], 3, 0);
-
-    logalways("Set tile");
-    logalways("format:    %d", rdp->tiles[tile_index].format);
-    logalways("size:      %d", rdp->tiles[tile_index].size);
-    logalways("line:      %d", rdp->tiles[tile_index].line);
-    logalways("tmem_adrs: %d", rdp->tiles[tile_index].tmem_adrs);
-    logalways("palette:   %d", rdp->tiles[tile_index].palette);
-    logalways("ct:        %d", rdp->tiles[tile_index].ct);
-    logalways("mt:        %d", rdp->tiles[tile_index].mt);
-    logalways("mask_t:    %d", rdp->tiles[tile_index].mask_t);
-    logalways("shift_t:   %d", rdp->tiles[tile_index].shift_t);
-    logalways("cs:        %d", rdp->tiles[tile_index].cs);
-    logalways("ms:        %d", rdp->tiles[tile_index].ms);
-    logalways("mask_s:    %d", rdp->tiles[tile_index].mask_s);
-    logalways("shift_s:   %d", rdp->tiles[tile_index].shift_s);
 }
 
 DEF_RDP_COMMAND(fill_rectangle) {
@@ -1035,7 +2067,6 @@ DEF_RDP_COMMAND(fill_rectangle) {
 
     int xh = get_bits(buffer[0], 23, 12) >> 2;
     int yh = get_bits(buffer[0], 11, 0) >> 2;
-    logalways("Fill rectangle (%d, %d) (%d, %d) with color %08X", xh, yh, xl, yl, rdp->fill_color);
 
     int bytes_per_pixel = get_bytes_per_pixel(rdp);
 
@@ -1043,24 +2074,37 @@ DEF_RDP_COMMAND(fill_rectangle) {
     int x_end = (xl + 1) * bytes_per_pixel;
 
     int stride = rdp->color_image.width * bytes_per_pixel;
+    const uint32_t pattern = get_fill_pattern(rdp);
+
+    if (x_start == 0 && x_end == stride && yl > yh && band_count == 1) {
+        // Full width, usually a clear: the rows are back to back, so it's all one span
+        uint32_t start = rdp->color_image.dram_addr + yh * stride;
+        fill_span(rdp, start, start + (yl - yh) * stride, pattern);
+        return;
+    }
 
     for (int y = yh; y < yl; y++) {
-        int yofs = y * stride;
-        for (int x = x_start; x < x_end; x += 2) {
-            uint32_t addr = rdp->color_image.dram_addr + yofs + x;
-            rdram_write16(rdp, addr, fill_for_addr(rdp, addr));
+        if (!owns_row(y)) {
+            continue;
         }
+        uint32_t line = rdp->color_image.dram_addr + y * stride;
+        fill_span(rdp, line + x_start, line + x_end, pattern);
     }
 }
 
 DEF_RDP_COMMAND(set_fill_color) {
     rdp->fill_color = get_bits(buffer[0], 31, 0);
-    logalways("Fill color cmd word: %016" PRIX64, buffer[0]);
-    logalways("Fill color: 0x%08X", rdp->fill_color);
+}
+
+INLINE void get_rgba(uint64_t word, color_32bpp_t* color) {
+    color->r = get_bits(word, 31, 24);
+    color->g = get_bits(word, 23, 16);
+    color->b = get_bits(word, 15, 8);
+    color->a = get_bits(word, 7, 0);
 }
 
 DEF_RDP_COMMAND(set_fog_color) {
-    logfatal("set_fog_color unimplemented");
+    get_rgba(buffer[0], &rdp->fog_color);
 }
 
 DEF_RDP_COMMAND(set_blend_color) {
@@ -1068,20 +2112,19 @@ DEF_RDP_COMMAND(set_blend_color) {
     rdp->blend_color.g = get_bits(buffer[0], 23, 16);
     rdp->blend_color.b = get_bits(buffer[0], 15, 8);
     rdp->blend_color.a = get_bits(buffer[0], 7, 0);
-
-    logalways("Blend color: #%02X%02X%02X alpha %02X", rdp->blend_color.r, rdp->blend_color.g, rdp->blend_color.b, rdp->blend_color.a);
 }
 
 DEF_RDP_COMMAND(set_prim_color) {
-    logfatal("set_prim_color unimplemented");
+    rdp->prim_lod_frac = get_bits(buffer[0], 39, 32);
+    get_rgba(buffer[0], &rdp->prim_color);
 }
 
 DEF_RDP_COMMAND(set_env_color) {
-    logfatal("set_env_color unimplemented");
+    get_rgba(buffer[0], &rdp->env_color);
 }
 
 DEF_RDP_COMMAND(set_combine) {
-    logalways("Set combine: %016" PRIX64, buffer[0]);
+    rdp->combine_raw = buffer[0];
     rdp->combine.sub_a_R_0 = get_bits(buffer[0], 55, 52);
     rdp->combine.mul_R_0   = get_bits(buffer[0], 51, 47);
     rdp->combine.sub_a_A_0 = get_bits(buffer[0], 46, 44);
@@ -1106,41 +2149,21 @@ DEF_RDP_COMMAND(set_texture_image) {
 
     rdp->texture_image.width     = get_bits(buffer[0], 41, 32) + 1;
     rdp->texture_image.dram_addr = get_bits(buffer[0], 25, 0);
-    logalways("Set texture image:");
-    logalways("format: %d", rdp->texture_image.format);
-    logalways("size: %d", rdp->texture_image.size);
-
-    logalways("width: %d", rdp->texture_image.width);
-    logalways("dram_addr: %08X", rdp->texture_image.dram_addr);
 }
 
 DEF_RDP_COMMAND(set_mask_image) {
     rdp->z_image = get_bits(buffer[0], 25, 0);
-    logalways("Setting Zbuffer image to 0x%08X", rdp->z_image);
 }
 
 DEF_RDP_COMMAND(set_color_image) {
-    logalways("Set color image %016" PRIX64 ":", buffer[0]);
     rdp->color_image.format    = get_bits(buffer[0], 55, 53);
     rdp->color_image.size      = get_bits(buffer[0], 52, 51);
     rdp->color_image.width     = get_bits(buffer[0], 41, 32) + 1;
     rdp->color_image.dram_addr = get_bits(buffer[0], 25, 0);
-    logalways("Format: %d", rdp->color_image.format);
-    logalways("Size: %d",   rdp->color_image.size);
-    logalways("Width: %d",  rdp->color_image.width);
-    logalways("DRAM addr: 0x%08X", rdp->color_image.dram_addr);
 }
 
 
-void softrdp_enqueue_command(softrdp_state_t* rdp, int command_length, uint64_t* buffer) {
-    for (int i = 0; i < (command_length >> 1); i++) {
-        uint64_t lo = (buffer[i] >>  0) & 0xFFFFFFFF;
-        uint64_t hi = (buffer[i] >> 32) & 0xFFFFFFFF;
-        buffer[i] = (lo << 32) | hi;
-    }
-
-    auto command = static_cast<rdp_command_t>(get_bits(buffer[0], 61, 56));
-
+INLINE void execute_command(softrdp_state_t* rdp, rdp_command_t command, int command_length, const uint64_t* buffer) {
     switch (command) {
         case RDP_COMMAND_FILL_TRIANGLE:                  EXEC_RDP_COMMAND(fill_triangle);
         case RDP_COMMAND_FILL_ZBUFFER_TRIANGLE:          EXEC_RDP_COMMAND(fill_zbuffer_triangle);
@@ -1181,3 +2204,342 @@ void softrdp_enqueue_command(softrdp_state_t* rdp, int command_length, uint64_t*
         default: logfatal("Unknown RDP command: %02X", command);
     }
 }
+
+// Commands that write to RDRAM. Everything else only changes state.
+INLINE bool is_primitive(rdp_command_t command) {
+    switch (command) {
+        case RDP_COMMAND_FILL_TRIANGLE:
+        case RDP_COMMAND_FILL_ZBUFFER_TRIANGLE:
+        case RDP_COMMAND_TEXTURE_TRIANGLE:
+        case RDP_COMMAND_TEXTURE_ZBUFFER_TRIANGLE:
+        case RDP_COMMAND_SHADE_TRIANGLE:
+        case RDP_COMMAND_SHADE_ZBUFFER_TRIANGLE:
+        case RDP_COMMAND_SHADE_TEXTURE_TRIANGLE:
+        case RDP_COMMAND_SHADE_TEXTURE_ZBUFFER_TRIANGLE:
+        case RDP_COMMAND_TEXTURE_RECTANGLE:
+        case RDP_COMMAND_TEXTURE_RECTANGLE_FLIP:
+        case RDP_COMMAND_FILL_RECTANGLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Commands that read RDRAM into TMEM
+INLINE bool is_load(rdp_command_t command) {
+    return command == RDP_COMMAND_LOAD_TLUT || command == RDP_COMMAND_LOAD_BLOCK || command == RDP_COMMAND_LOAD_TILE;
+}
+
+INLINE bool is_sync(rdp_command_t command) {
+    return command == RDP_COMMAND_SYNC_LOAD || command == RDP_COMMAND_SYNC_PIPE
+        || command == RDP_COMMAND_SYNC_TILE || command == RDP_COMMAND_SYNC_FULL;
+}
+
+typedef struct softrdp_primitive {
+    uint64_t buffer[SOFTRDP_MAX_COMMAND_WORDS];
+    rdp_command_t command;
+    int command_length;
+    // Index into the state snapshots
+    size_t state;
+} softrdp_primitive_t;
+
+// Primitives are queued up along with a snapshot of the state they were enqueued with, and rasterized on a flush.
+// Every thread walks the whole queue in order, but only touches the scanlines in its own bands, so no two threads
+// ever write the same pixel and each pixel still sees the primitives in the order they were sent.
+struct softrdp_workers {
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    // Signalled by the emulation thread when there's a new queue to rasterize, or when it's time to quit
+    std::condition_variable work;
+    // Signalled by the last worker to finish the queue
+    std::condition_variable done;
+
+    // Protected by lock
+    uint64_t generation = 0;
+    int remaining = 0;
+    bool quit = false;
+
+    // Only touched by the emulation thread, or by the workers between a flush starting and finishing
+    std::vector<softrdp_state_t> snapshots;
+    std::vector<softrdp_primitive_t> primitives;
+    // Set whenever a state command ran since the last snapshot
+    bool state_dirty = true;
+    // Conservative range of RDRAM the queue will write to, loads from inside it have to wait for the queue
+    uint32_t written_start = UINT32_MAX;
+    uint32_t written_end = 0;
+};
+
+static void rasterize_band(softrdp_workers* workers, int index) {
+    band_index = index;
+    band_count = (int)workers->threads.size() + 1;
+    for (const softrdp_primitive_t& primitive : workers->primitives) {
+        execute_command(&workers->snapshots[primitive.state], primitive.command, primitive.command_length, primitive.buffer);
+    }
+}
+
+static void worker_main(softrdp_workers* workers, int index) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> guard(workers->lock);
+    while (true) {
+        workers->work.wait(guard, [&] { return workers->quit || workers->generation != seen; });
+        if (workers->quit) {
+            return;
+        }
+        seen = workers->generation;
+        guard.unlock();
+
+        rasterize_band(workers, index);
+
+        guard.lock();
+        if (--workers->remaining == 0) {
+            workers->done.notify_one();
+        }
+    }
+}
+
+void softrdp_start_workers(softrdp_state_t* rdp, int threads) {
+    if (rdp->workers != NULL) {
+        return;
+    }
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    if (threads <= 1) {
+        return;
+    }
+
+    auto* workers = new softrdp_workers();
+    workers->snapshots.reserve(SOFTRDP_MAX_QUEUED_PRIMITIVES);
+    workers->primitives.reserve(SOFTRDP_MAX_QUEUED_PRIMITIVES);
+    // The emulation thread rasterizes band 0 itself while it waits
+    for (int i = 1; i < threads; i++) {
+        workers->threads.emplace_back(worker_main, workers, i);
+    }
+    rdp->workers = workers;
+    logalways("Rasterizing on %d threads", threads);
+}
+
+static void flush_workers(softrdp_state_t* rdp) {
+    softrdp_workers* workers = rdp->workers;
+    if (workers == NULL || workers->primitives.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(workers->lock);
+        workers->generation++;
+        workers->remaining = (int)workers->threads.size();
+    }
+    workers->work.notify_all();
+
+    rasterize_band(workers, 0);
+
+    {
+        std::unique_lock<std::mutex> guard(workers->lock);
+        workers->done.wait(guard, [&] { return workers->remaining == 0; });
+    }
+
+    workers->primitives.clear();
+    workers->snapshots.clear();
+    workers->state_dirty = true;
+    workers->written_start = UINT32_MAX;
+    workers->written_end = 0;
+}
+
+INLINE void mark_written(softrdp_workers* workers, uint32_t image, uint32_t bytes) {
+    workers->written_start = image < workers->written_start ? image : workers->written_start;
+    workers->written_end = image + bytes > workers->written_end ? image + bytes : workers->written_end;
+}
+
+INLINE void queue_primitive(softrdp_state_t* rdp, rdp_command_t command, int command_length, const uint64_t* buffer) {
+    softrdp_workers* workers = rdp->workers;
+    if (workers->primitives.size() >= SOFTRDP_MAX_QUEUED_PRIMITIVES) {
+        flush_workers(rdp);
+    }
+
+    if (workers->state_dirty) {
+        workers->snapshots.push_back(*rdp);
+        workers->state_dirty = false;
+    }
+
+    softrdp_primitive_t primitive;
+    memcpy(primitive.buffer, buffer, (command_length >> 1) * sizeof(uint64_t));
+    primitive.command = command;
+    primitive.command_length = command_length;
+    primitive.state = workers->snapshots.size() - 1;
+    workers->primitives.push_back(primitive);
+
+    // Everything up to the bottom of the scissor, or the most a 10.2 coordinate can reach without one
+    int lines = (rdp->scissor.yl >> 2) + 1;
+    if (rdp->scissor.xl == 0 && rdp->scissor.yl == 0) {
+        lines = 0x400;
+    }
+    uint32_t color_bytes = lines * rdp->color_image.width * get_bytes_per_pixel(rdp);
+    mark_written(workers, rdp->color_image.dram_addr, color_bytes);
+    mark_written(workers, rdp->z_image, lines * rdp->color_image.width * 2);
+}
+
+static void run_command(softrdp_state_t* rdp, rdp_command_t command, int command_length, const uint64_t* buffer) {
+    rdp_trace(RDP_TRACE_COMMAND, command, buffer[0], command_length > 2 ? buffer[1] : 0);
+
+    if (rdp->workers != NULL) {
+        softrdp_workers* workers = rdp->workers;
+        if (is_primitive(command)) {
+            queue_primitive(rdp, command, command_length, buffer);
+            return;
+        }
+
+        // Rendering to a texture and loading it straight back needs the rendering done first
+        if (is_load(command) && rdp->texture_image.dram_addr >= workers->written_start
+                && rdp->texture_image.dram_addr < workers->written_end) {
+            flush_workers(rdp);
+        }
+
+        if (!is_sync(command)) {
+            workers->state_dirty = true;
+        }
+    }
+
+    execute_command(rdp, command, command_length, buffer);
+}
+
+// Commands cross over to the RDP thread already joined into 64 bit words, each one behind one of these.
+typedef struct softrdp_ring_header {
+    uint32_t command;
+    // Zero asks the RDP thread to finish everything before it and report back
+    uint32_t command_length;
+} softrdp_ring_header_t;
+
+// A single producer, single consumer ring laid out like common/fifo.h: only the emulation thread moves the tail, only
+// the RDP thread moves the head, and the last byte is never used so a full ring doesn't look empty.
+struct softrdp_thread {
+    std::thread thread;
+    std::unique_ptr<uint8_t[]> data{new uint8_t[SOFTRDP_RING_SIZE]};
+    std::atomic<int> head{0};
+    std::atomic<int> tail{0};
+
+    // Set while the RDP thread waits for commands, the emulation thread only takes the lock to wake it up
+    std::atomic<bool> sleeping{false};
+    std::mutex lock;
+    std::condition_variable work;
+    std::condition_variable idle;
+    // Only touched by the emulation thread
+    uint64_t flushes_requested = 0;
+    // Protected by lock
+    uint64_t flushes_done = 0;
+};
+
+INLINE int ring_read_available(softrdp_thread* thread) {
+    return (thread->tail.load() - thread->head.load()) & (SOFTRDP_RING_SIZE - 1);
+}
+
+INLINE int ring_write_remaining(softrdp_thread* thread) {
+    return (SOFTRDP_RING_SIZE - 1) - ring_read_available(thread);
+}
+
+INLINE void ring_write(softrdp_thread* thread, const void* buf, int size) {
+    const auto* bytes = static_cast<const uint8_t*>(buf);
+    int tail = thread->tail.load(std::memory_order_relaxed);
+    if (tail + size > SOFTRDP_RING_SIZE) {
+        int size_a = SOFTRDP_RING_SIZE - tail;
+        memcpy(&thread->data[tail], bytes, size_a);
+        memcpy(&thread->data[0], bytes + size_a, size - size_a);
+    } else {
+        memcpy(&thread->data[tail], bytes, size);
+    }
+    thread->tail.store((tail + size) & (SOFTRDP_RING_SIZE - 1));
+}
+
+INLINE void ring_read(softrdp_thread* thread, void* buf, int size) {
+    auto* bytes = static_cast<uint8_t*>(buf);
+    int head = thread->head.load(std::memory_order_relaxed);
+    if (head + size > SOFTRDP_RING_SIZE) {
+        int size_a = SOFTRDP_RING_SIZE - head;
+        memcpy(bytes, &thread->data[head], size_a);
+        memcpy(bytes + size_a, &thread->data[0], size - size_a);
+    } else {
+        memcpy(bytes, &thread->data[head], size);
+    }
+    thread->head.store((head + size) & (SOFTRDP_RING_SIZE - 1));
+}
+
+static void rdp_thread_main(softrdp_state_t* rdp) {
+    softrdp_thread* thread = rdp->thread;
+    uint64_t buffer[SOFTRDP_MAX_COMMAND_WORDS];
+    while (true) {
+        if (ring_read_available(thread) == 0) {
+            std::unique_lock<std::mutex> guard(thread->lock);
+            thread->sleeping = true;
+            thread->work.wait(guard, [&] { return ring_read_available(thread) != 0; });
+            thread->sleeping = false;
+        }
+
+        softrdp_ring_header_t header;
+        ring_read(thread, &header, sizeof(header));
+        if (header.command_length == 0) {
+            flush_workers(rdp);
+            std::lock_guard<std::mutex> guard(thread->lock);
+            thread->flushes_done++;
+            thread->idle.notify_all();
+            continue;
+        }
+        ring_read(thread, buffer, (header.command_length >> 1) * sizeof(uint64_t));
+        run_command(rdp, static_cast<rdp_command_t>(header.command), header.command_length, buffer);
+    }
+}
+
+INLINE void push_command(softrdp_thread* thread, const void* entry, int size) {
+    while (ring_write_remaining(thread) < size) {
+        std::this_thread::yield();
+    }
+    ring_write(thread, entry, size);
+    if (thread->sleeping) {
+        std::lock_guard<std::mutex> guard(thread->lock);
+        thread->work.notify_one();
+    }
+}
+
+void softrdp_start_thread(softrdp_state_t* rdp) {
+    if (rdp->thread != NULL) {
+        return;
+    }
+    rdp->thread = new softrdp_thread();
+    rdp->thread->thread = std::thread(rdp_thread_main, rdp);
+    logalways("Running the software RDP on its own thread");
+}
+
+void softrdp_flush(softrdp_state_t* rdp) {
+    softrdp_thread* thread = rdp->thread;
+    if (thread == NULL) {
+        flush_workers(rdp);
+        return;
+    }
+
+    // The RDP thread only gets to the request once everything before it has run
+    softrdp_ring_header_t request = {0, 0};
+    uint64_t target = ++thread->flushes_requested;
+    push_command(thread, &request, sizeof(request));
+
+    std::unique_lock<std::mutex> guard(thread->lock);
+    thread->idle.wait(guard, [&] { return thread->flushes_done >= target; });
+}
+
+void softrdp_enqueue_command(softrdp_state_t* rdp, int command_length, const uint32_t* words) {
+    // The words are read straight out of RDRAM or DMEM, so they're joined into a copy rather than in place
+    struct {
+        softrdp_ring_header_t header;
+        uint64_t buffer[SOFTRDP_MAX_COMMAND_WORDS];
+    } entry;
+    for (int i = 0; i < (command_length >> 1); i++) {
+        entry.buffer[i] = (uint64_t)words[i * 2] << 32 | words[i * 2 + 1];
+    }
+    auto command = static_cast<rdp_command_t>(get_bits(entry.buffer[0], 61, 56));
+
+    if (rdp->thread != NULL) {
+        entry.header.command = command;
+        entry.header.command_length = command_length;
+        push_command(rdp->thread, &entry, sizeof(entry.header) + (command_length >> 1) * sizeof(uint64_t));
+    } else {
+        run_command(rdp, command, command_length, entry.buffer);
+    }
+}
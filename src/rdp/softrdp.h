@@ -11,7 +11,7 @@ typedef struct softrdp_tile {
     uint8_t format;
     uint8_t size;
     uint8_t line;
-    uint8_t tmem_adrs;
+    uint16_t tmem_adrs;
     uint8_t palette;
     bool ct;
     bool mt;
@@ -21,6 +21,12 @@ typedef struct softrdp_tile {
     bool ms;
     uint8_t mask_s;
     uint8_t shift_s;
+
+    // Set by set_tile_size and load_tile, in 10.2 fixed point
+    uint16_t sl;
+    uint16_t tl;
+    uint16_t sh;
+    uint16_t th;
 } softrdp_tile_t;
 
 typedef enum blender_source {
@@ -32,7 +38,7 @@ typedef enum blender_source {
 
     // Alphas
     BLENDER_PIXEL_ALPHA,
-    BLENDER_PRIMITIVE_ALPHA,
+    BLENDER_FOG_ALPHA,
     BLENDER_SHADE_ALPHA,
     BLENDER_ONE_MINUS_ALPHA,
     BLENDER_MEMORY_ALPHA,
@@ -67,8 +73,15 @@ typedef union color_16bpp {
     };
 } __attribute__((__packed__)) color_16bpp_t;
 
+struct softrdp_workers;
+struct softrdp_thread;
+
 typedef struct softrdp_state {
     uint8_t* rdram;
+    // NULL when primitives are rasterized as soon as they're enqueued
+    struct softrdp_workers* workers;
+    // NULL when commands run on the emulation thread as soon as they're enqueued
+    struct softrdp_thread* thread;
 
     struct {
         uint16_t xl;
@@ -91,6 +104,10 @@ typedef struct softrdp_state {
     } color_image;
 
     color_32bpp_t blend_color;
+    color_32bpp_t fog_color;
+    color_32bpp_t prim_color;
+    color_32bpp_t env_color;
+    uint8_t prim_lod_frac;
 
     struct {
         uint8_t format;
@@ -155,16 +172,34 @@ typedef struct softrdp_state {
         uint8_t add_A_1;
     } combine;
 
+    // The last set_other_modes and set_combine words, which compiled pixel pipelines are looked up by
+    uint64_t other_modes_raw;
+    uint64_t combine_raw;
+
     softrdp_tile_t tiles[8];
 
     u8 tmem[0x1000];
+    // Bumped whenever TMEM, a tile or the TLUT mode changes, decoded texels from an older generation are stale
+    uint32_t texture_generation;
 
     uint32_t z_image;
 } softrdp_state_t;
 
 void softrdp_init(softrdp_state_t* state, uint8_t* rdramptr);
-#define full_sync_softrdp() do {} while(0)
-void softrdp_enqueue_command(softrdp_state_t* rdp, int command_length, uint64_t* buffer);
+// Rasterizes primitives on this many threads, each one owning every n-th band of scanlines. 0 uses one per core.
+// Queued primitives are only drawn on softrdp_flush (full sync and VI scanout) or when a texture load reads what they
+// draw to, so CPU reads and DMA never check for them. That's enough for anything that works on hardware: the real RDP
+// runs alongside the CPU too, and games wait for the full sync interrupt before touching the color or Z image.
+void softrdp_start_workers(softrdp_state_t* rdp, int threads);
+// Runs commands on a thread of their own, fed through a ring. The emulation thread only waits for it in softrdp_flush.
+// Only used when asked for: nothing orders the thread's RDRAM accesses against the CPU, the RSP or PI/SI DMA. What it
+// draws is only visible after softrdp_flush (full sync and VI scanout), and texture loads read RDRAM whenever the thread
+// gets to them, so a game that reads the framebuffer before full sync or rewrites a texture still waiting to be loaded
+// sees something different from the synchronous RDP.
+void softrdp_start_thread(softrdp_state_t* rdp);
+// Waits until everything enqueued so far has been written to RDRAM.
+void softrdp_flush(softrdp_state_t* rdp);
+void softrdp_enqueue_command(softrdp_state_t* rdp, int command_length, const uint32_t* words);
 #endif
 
 #ifdef __cplusplus
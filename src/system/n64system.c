@@ -10,6 +10,7 @@
 #include <interface/vi.h>
 #include <interface/ai.h>
 #include <cpu/rsp.h>
+#include <cpu/rsp_vector_instructions.h>
 #include <cpu/dynarec/dynarec.h>
 #include <util.h>
 #ifndef N64_WIN
@@ -27,8 +28,11 @@
 #include <interface/si.h>
 #include <interface/pi.h>
 #include <dynarec/rsp_dynarec.h>
+#include <dynarec/dynarec_perf.h>
 #include <mem/pif.h>
 #include <timing.h>
+#include <cpu/guest_profiler.h>
+#include <system/rsp_thread.h>
 
 static bool should_quit = false;
 
@@ -50,6 +54,7 @@ bool n64_should_quit() {
 void n64_load_rom(const char* rom_path) {
     logalways("Loading %s", rom_path);
     load_n64rom(&n64sys.mem.rom, rom_path);
+    n64_bus_init_pages();
     n64sys.target_fps = n64sys.mem.rom.pal ? 50 : 60;
     gamedb_match(&n64sys);
     devices_init(n64sys.mem.save_type);
@@ -88,6 +93,7 @@ void init_n64system(const char* rom_path, bool enable_frontend, bool enable_debu
 
     mprotect_codecache();
     n64_dynarec_init(codecache, CODECACHE_SIZE);
+    rsp_vector_init();
     N64RSP.dynarec = rsp_dynarec_init(rsp_codecache, RSP_CODECACHE_SIZE);
 
     if (enable_frontend) {
@@ -162,9 +168,16 @@ void reset_n64system() {
     n64sys.vi.cycles_per_halfline = 1000;
 
     invalidate_dynarec_all_pages();
+    n64_bus_init_pages();
+
+    n64sys.vi.last_halfline_at = 0;
+    n64sys.vi.halfline = 0;
+    n64sys.vi.field = 0;
+    n64sys.vi.v_current = 0;
 
     scheduler_reset();
-    scheduler_enqueue_relative((u64)n64sys.vi.cycles_per_halfline, SCHEDULER_VI_HALFLINE);
+    vi_schedule_interrupt();
+    vi_schedule_field_complete();
 }
 
 INLINE int jit_system_step() {
@@ -176,6 +189,9 @@ INLINE int jit_system_step() {
 
 INLINE int interpreter_system_step_matchjit(const int cycles) {
     for (int i = 0; i < cycles; i++) {
+#ifdef N64_GUEST_PROFILER
+        guest_profiler_interpreter_step(N64CPU.pc);
+#endif
         r4300i_step();
 #ifdef INSTANT_DMA
         N64CPU.fcr31.flag = 0;
@@ -214,6 +230,9 @@ INLINE void interpreter_system_step() {
 
 #ifdef LOG_CPU_STATE
     log_cpu_state();
+#endif
+#ifdef N64_GUEST_PROFILER
+    guest_profiler_interpreter_step(N64CPU.pc);
 #endif
     r4300i_step();
 
@@ -234,43 +253,22 @@ INLINE void interpreter_system_step() {
     }
 }
 
-void on_vi_halfline_complete(u64 time) {
-    // VI timing
-    s64 taken = time - n64sys.vi.last_halfline_at;
-    n64sys.vi.last_halfline_at = time;
-
-    u64 overshot;
-
-    do {
-        overshot = taken - n64sys.vi.cycles_per_halfline;
-
-        n64sys.vi.halfline++;
-
-        if (n64sys.vi.halfline > n64sys.vi.num_halflines) {
-            n64sys.vi.halfline = 0;
-            n64sys.vi.field++;
-            if (n64sys.video_type != UNKNOWN_VIDEO_TYPE) {
-                persist_backup();
-                reset_all_metrics();
-                ai_step(n64sys.vi.missing_cycles);
-                rdp_update_screen();
-            }
-        }
-
-        if (n64sys.vi.field > n64sys.vi.num_fields) {
-            n64sys.vi.field = 0;
-        }
-
-        n64sys.vi.v_current = (n64sys.vi.halfline << 1) + n64sys.vi.field;
-        check_vi_interrupt();
-        taken -= n64sys.vi.cycles_per_halfline;
-    } while (taken > n64sys.vi.cycles_per_halfline);
-
-    u64 next_event = n64sys.vi.cycles_per_halfline - overshot;
-    scheduler_enqueue_relative(next_event, SCHEDULER_VI_HALFLINE);
+void on_vi_field_complete() {
+    vi_catch_up();
+    if (n64sys.video_type != UNKNOWN_VIDEO_TYPE) {
+        rsp_thread_sync();
+        persist_backup();
+        reset_all_metrics();
+        ai_step(n64sys.vi.missing_cycles);
+        rdp_update_screen();
+    }
+    vi_schedule_field_complete();
 }
 
 void handle_scheduler_event(scheduler_event_t* event) {
+#ifdef N64_GUEST_PROFILER
+    guest_profiler_check_dump();
+#endif
     switch (event->type) {
         case SCHEDULER_SI_DMA_COMPLETE:
             on_si_dma_complete();
@@ -281,10 +279,22 @@ void handle_scheduler_event(scheduler_event_t* event) {
         case SCHEDULER_PI_BUS_WRITE_COMPLETE:
             on_pi_write_complete();
             break;
-        case SCHEDULER_VI_HALFLINE:
-            on_vi_halfline_complete(n64scheduler.scheduler_ticks);
+        case SCHEDULER_VI_INTERRUPT:
+            vi_catch_up();
+            interrupt_raise(INTERRUPT_VI);
+            vi_schedule_interrupt();
+            break;
+        case SCHEDULER_VI_FIELD_COMPLETE:
+            on_vi_field_complete();
+            break;
+        case SCHEDULER_RSP_SYNC:
+            // Nothing to do here, the RSP catches up after every event. Keep coming back while it's running.
+            if (!N64RSP.status.halt) {
+                scheduler_enqueue_relative(RSP_SYNC_CYCLES, SCHEDULER_RSP_SYNC);
+            }
             break;
         case SCHEDULER_RESET_SYSTEM:
+            rsp_thread_sync();
             reset_n64system();
             n64_load_rom(n64sys.rom_path);
             pif_rom_execute();
@@ -340,6 +350,7 @@ int n64_system_step(bool dynarec, int steps) {
 }
 
 void check_vsync() {
+    vi_catch_up();
     if (n64sys.vi.v_current == n64sys.vi.vsync >> 1) {
         rdp_update_screen();
     }
@@ -350,20 +361,27 @@ void n64_queue_reset() {
 }
 
 void jit_system_loop() {
+    // Blocks chained together update the scheduler and count themselves, and only come back here when an event is due.
+    n64dynarec.link_blocks = true;
+    rsp_thread_start();
     while (!should_quit) {
         static int cpu_steps = 0;
+        u64 start_ticks = n64scheduler.scheduler_ticks;
         while (true) {
             int taken = jit_system_step();
-            cpu_steps += taken;
             static scheduler_event_t event;
             if (scheduler_tick(taken, &event)) {
                 handle_scheduler_event(&event);
                 break;
             }
         }
+        cpu_steps += n64scheduler.scheduler_ticks - start_ticks;
 
         ai_step(cpu_steps);
-        if (!N64RSP.status.halt) {
+        if (rsp_thread_running) {
+            rsp_thread_run_cycles(cpu_steps);
+            cpu_steps = 0;
+        } else if (!N64RSP.status.halt) {
             // 2 RSP steps per 3 CPU steps
             N64RSP.steps += (cpu_steps / 3) * 2;
             cpu_steps %= 3;
@@ -374,6 +392,8 @@ void jit_system_loop() {
             cpu_steps = 0;
         }
     }
+    n64dynarec.link_blocks = false;
+    rsp_thread_stop();
     force_persist_backup();
 }
 
@@ -397,6 +417,7 @@ void n64_system_loop() {
 }
 
 void n64_system_cleanup() {
+    rsp_thread_stop();
 #ifndef N64_WIN
     debugger_cleanup();
 #endif
@@ -406,6 +427,8 @@ void n64_system_cleanup() {
 
     free(n64sys.mem.rom.pif_rom);
     n64sys.mem.rom.pif_rom = NULL;
+
+    dynarec_perf_close();
 }
 
 void n64_request_quit() {
@@ -420,6 +443,9 @@ void on_interrupt_change() {
 }
 
 void interrupt_raise(n64_interrupt_t interrupt) {
+    if (rsp_thread_defer_interrupt(interrupt, true)) {
+        return;
+    }
     switch (interrupt) {
         case INTERRUPT_VI:
             loginfo("Raising VI interrupt");
@@ -458,6 +484,9 @@ void interrupt_raise(n64_interrupt_t interrupt) {
 }
 
 void interrupt_lower(n64_interrupt_t interrupt) {
+    if (rsp_thread_defer_interrupt(interrupt, false)) {
+        return;
+    }
     switch (interrupt) {
         case INTERRUPT_VI:
             n64sys.mi.intr.vi = false;
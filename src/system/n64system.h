@@ -14,6 +14,8 @@ extern "C" {
 
 #define CPU_HERTZ 93750000
 #define CPU_CYCLES_PER_FRAME (CPU_HERTZ / n64sys.target_fps)
+// How often the RSP catches up with the CPU in the JIT loop while it's running, about one VI halfline
+#define RSP_SYNC_CYCLES 6000
 #define CYCLES_PER_INSTR 1
 
 // The CPU runs at 93.75mhz. There are 60 frames per second, and 262 lines on the display.
@@ -0,0 +1,223 @@
+#include "rsp_thread.h"
+
+#include <SDL.h>
+#include <log.h>
+#include <cpu/rsp.h>
+#include <cpu/dynarec/dynarec.h>
+
+// RSP DMA can address 16MiB of RDRAM
+#define RSP_THREAD_NUM_PAGES (((RSP_DRAM_ADDR_MASK | 0xFFF) + 1) >> BLOCKCACHE_OUTER_SHIFT)
+
+bool rsp_thread_running = false;
+
+static bool enabled = false;
+static int tolerance = RSP_THREAD_DEFAULT_TOLERANCE;
+
+static SDL_Thread* thread = NULL;
+static SDL_threadID thread_id;
+static SDL_mutex* lock = NULL;
+// Signalled by the CPU thread when there are new steps to run, or when it's time to quit
+static SDL_cond* work = NULL;
+// Signalled by the RSP thread whenever it finishes a batch of steps
+static SDL_cond* idle = NULL;
+
+// Everything below is protected by lock.
+static bool quit = false;
+static bool busy = false;
+static int granted_steps = 0;
+static int in_flight_steps = 0;
+static int cycle_carry = 0;
+
+static u32 pending_raise = 0;
+static u32 pending_lower = 0;
+static bool pending_invalidate_any = false;
+static u64 pending_invalidate[RSP_THREAD_NUM_PAGES / 64];
+
+static int rsp_thread_main(void* data) {
+    SDL_LockMutex(lock);
+    while (!quit) {
+        if (granted_steps > 0 && !N64RSP.status.halt) {
+            N64RSP.steps += granted_steps;
+            in_flight_steps = granted_steps;
+            granted_steps = 0;
+            busy = true;
+            SDL_UnlockMutex(lock);
+
+            rsp_dynarec_run();
+
+            SDL_LockMutex(lock);
+            busy = false;
+            in_flight_steps = 0;
+            SDL_CondBroadcast(idle);
+        } else {
+            if (N64RSP.status.halt) {
+                granted_steps = 0;
+                N64RSP.steps = 0;
+            }
+            SDL_CondBroadcast(idle);
+            SDL_CondWait(work, lock);
+        }
+    }
+    SDL_UnlockMutex(lock);
+    return 0;
+}
+
+INLINE bool on_rsp_thread() {
+    return rsp_thread_running && SDL_ThreadID() == thread_id;
+}
+
+// Applies everything the RSP thread couldn't do itself. Only called from the CPU thread.
+static void apply_pending() {
+    SDL_LockMutex(lock);
+    u32 raise = pending_raise;
+    u32 lower = pending_lower;
+    pending_raise = 0;
+    pending_lower = 0;
+
+    if (pending_invalidate_any) {
+        for (int i = 0; i < RSP_THREAD_NUM_PAGES / 64; i++) {
+            u64 pages = pending_invalidate[i];
+            pending_invalidate[i] = 0;
+            while (pages != 0) {
+                int page = (i * 64) + __builtin_ctzll(pages);
+                pages &= pages - 1;
+                if (n64dynarec.blockcache[page] != NULL) {
+                    invalidate_dynarec_page_by_index(page);
+                }
+            }
+        }
+        pending_invalidate_any = false;
+    }
+    SDL_UnlockMutex(lock);
+
+    for (int interrupt = 0; raise | lower; interrupt++) {
+        u32 bit = 1 << interrupt;
+        if (raise & bit) {
+            interrupt_raise(interrupt);
+        } else if (lower & bit) {
+            interrupt_lower(interrupt);
+        }
+        raise &= ~bit;
+        lower &= ~bit;
+    }
+}
+
+void rsp_thread_init(int new_tolerance) {
+    enabled = true;
+    tolerance = new_tolerance;
+}
+
+void rsp_thread_start() {
+    if (!enabled || rsp_thread_running) {
+        return;
+    }
+
+    lock = SDL_CreateMutex();
+    work = SDL_CreateCond();
+    idle = SDL_CreateCond();
+    quit = false;
+    busy = false;
+    granted_steps = 0;
+    in_flight_steps = 0;
+    cycle_carry = 0;
+
+    thread = SDL_CreateThread(rsp_thread_main, "RSP", NULL);
+    if (thread == NULL) {
+        logwarn("Unable to start the RSP thread, running the RSP inline: %s", SDL_GetError());
+        SDL_DestroyCond(idle);
+        SDL_DestroyCond(work);
+        SDL_DestroyMutex(lock);
+        return;
+    }
+    thread_id = SDL_GetThreadID(thread);
+    rsp_thread_running = true;
+    logalways("Running the RSP on its own thread, allowing it to fall %d steps behind", tolerance);
+}
+
+void rsp_thread_stop() {
+    if (!rsp_thread_running) {
+        return;
+    }
+
+    rsp_thread_wait_idle();
+
+    SDL_LockMutex(lock);
+    quit = true;
+    SDL_CondSignal(work);
+    SDL_UnlockMutex(lock);
+    SDL_WaitThread(thread, NULL);
+
+    rsp_thread_running = false;
+    thread = NULL;
+    SDL_DestroyCond(idle);
+    SDL_DestroyCond(work);
+    SDL_DestroyMutex(lock);
+}
+
+// Replaces the inline "2 RSP steps per 3 CPU steps" catch-up in the JIT loop.
+void rsp_thread_run_cycles(int cpu_cycles) {
+    apply_pending();
+
+    SDL_LockMutex(lock);
+    if (!busy && N64RSP.status.halt) {
+        cycle_carry = 0;
+        granted_steps = 0;
+        N64RSP.steps = 0;
+    } else {
+        cycle_carry += cpu_cycles;
+        granted_steps += (cycle_carry / 3) * 2;
+        cycle_carry %= 3;
+        SDL_CondSignal(work);
+
+        while (busy && granted_steps + in_flight_steps > tolerance) {
+            SDL_CondWait(idle, lock);
+        }
+    }
+    SDL_UnlockMutex(lock);
+}
+
+// Waits until the RSP has run every step it was given, or halted.
+void rsp_thread_wait_idle() {
+    if (on_rsp_thread()) {
+        return;
+    }
+
+    SDL_LockMutex(lock);
+    while (busy || (granted_steps > 0 && !N64RSP.status.halt)) {
+        SDL_CondWait(idle, lock);
+    }
+    SDL_UnlockMutex(lock);
+
+    apply_pending();
+}
+
+// Only the last raise or lower of each interrupt matters, the CPU couldn't have seen the ones before it anyway.
+bool rsp_thread_defer_interrupt(n64_interrupt_t interrupt, bool raise) {
+    if (!on_rsp_thread()) {
+        return false;
+    }
+
+    SDL_LockMutex(lock);
+    if (raise) {
+        pending_raise |= 1 << interrupt;
+        pending_lower &= ~(1 << interrupt);
+    } else {
+        pending_lower |= 1 << interrupt;
+        pending_raise &= ~(1 << interrupt);
+    }
+    SDL_UnlockMutex(lock);
+    return true;
+}
+
+bool rsp_thread_defer_invalidate(u32 physical_address) {
+    if (!on_rsp_thread()) {
+        return false;
+    }
+
+    u32 page = (physical_address & RSP_DRAM_ADDR_MASK) >> BLOCKCACHE_OUTER_SHIFT;
+    SDL_LockMutex(lock);
+    pending_invalidate[page / 64] |= 1ULL << (page % 64);
+    pending_invalidate_any = true;
+    SDL_UnlockMutex(lock);
+    return true;
+}
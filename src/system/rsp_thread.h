@@ -0,0 +1,31 @@
+#ifndef N64_RSP_THREAD_H
+#define N64_RSP_THREAD_H
+
+#include <util.h>
+#include <system/n64system.h>
+
+// Optionally runs the RSP on its own host thread, only available with the JIT.
+// The CPU thread still decides how many steps the RSP gets, at the same points it would have run the RSP inline, but
+// doesn't wait for them to finish unless more than the tolerance are outstanding. Before the CPU touches anything the
+// RSP can see (SP/DP registers, DMEM/IMEM, the screen) it waits for the RSP to catch up.
+// Interrupts raised and code invalidated by the RSP thread are handed back to the CPU thread to apply.
+
+#define RSP_THREAD_DEFAULT_TOLERANCE 10000
+
+extern bool rsp_thread_running;
+
+void rsp_thread_init(int tolerance);
+void rsp_thread_start();
+void rsp_thread_stop();
+void rsp_thread_run_cycles(int cpu_cycles);
+void rsp_thread_wait_idle();
+bool rsp_thread_defer_interrupt(n64_interrupt_t interrupt, bool raise);
+bool rsp_thread_defer_invalidate(u32 physical_address);
+
+INLINE void rsp_thread_sync() {
+    if (unlikely(rsp_thread_running)) {
+        rsp_thread_wait_idle();
+    }
+}
+
+#endif //N64_RSP_THREAD_H
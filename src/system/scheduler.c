@@ -2,90 +2,126 @@
 #include <log.h>
 #include "scheduler.h"
 
+#define INITIAL_HEAP_CAPACITY 16
+
 scheduler_t n64scheduler;
 
-// pops a pointer off of the free event nodes stack
-scheduler_event_node_t* alloc_event_node() {
-    if (n64scheduler.free_event_nodes_stack_ptr == 0) {
-        logfatal("Ran out of free scheduler event nodes!");
+// Events due at the same time fire in the order they were enqueued. The sorted list this replaced put a new event in
+// front of the ones already due at its time (after the first one, if that was the head), so they mostly fired newest
+// first.
+INLINE bool entry_before(const scheduler_heap_entry_t* a, const scheduler_heap_entry_t* b) {
+    if (a->event.time != b->event.time) {
+        return a->event.time < b->event.time;
     }
-    return n64scheduler.free_event_nodes[--n64scheduler.free_event_nodes_stack_ptr];
+    return a->sequence < b->sequence;
 }
 
-// pushes this pointer onto the free event nodes stack
-void free_event_node(scheduler_event_node_t* node) {
-    n64scheduler.free_event_nodes[n64scheduler.free_event_nodes_stack_ptr++] = node;
+INLINE void swap_entries(int a, int b) {
+    scheduler_heap_entry_t temp = n64scheduler.heap[a];
+    n64scheduler.heap[a] = n64scheduler.heap[b];
+    n64scheduler.heap[b] = temp;
 }
 
-void scheduler_reset() {
-    n64scheduler.scheduler_ticks = 0;
-    n64scheduler.free_event_nodes_stack_ptr = 0;
-    n64scheduler.scheduler_list = NULL;
+static void sift_up(int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!entry_before(&n64scheduler.heap[index], &n64scheduler.heap[parent])) {
+            break;
+        }
+        swap_entries(index, parent);
+        index = parent;
+    }
+}
 
-    for (int i = 0; i < NUM_EVENT_NODES; i++) {
-        free_event_node(&n64scheduler.event_nodes[i]);
+static void sift_down(int index) {
+    while (true) {
+        int left = index * 2 + 1;
+        int right = left + 1;
+        int smallest = index;
+        if (left < n64scheduler.heap_size && entry_before(&n64scheduler.heap[left], &n64scheduler.heap[smallest])) {
+            smallest = left;
+        }
+        if (right < n64scheduler.heap_size && entry_before(&n64scheduler.heap[right], &n64scheduler.heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        swap_entries(index, smallest);
+        index = smallest;
     }
 }
 
-bool scheduler_tick(u64 ticks, scheduler_event_t* event) {
-    n64scheduler.scheduler_ticks += ticks;
+INLINE void update_next_event_time() {
+    n64scheduler.next_event_time = n64scheduler.heap_size > 0 ? n64scheduler.heap[0].event.time : UINT64_MAX;
+}
 
-    bool event_occurred = (n64scheduler.scheduler_list != NULL) && n64scheduler.scheduler_list->event.time < n64scheduler.scheduler_ticks;
+// Removes the entry at index, moving the last entry into its place and restoring the heap around it.
+static void remove_at(int index) {
+    int last = --n64scheduler.heap_size;
+    if (index != last) {
+        n64scheduler.heap[index] = n64scheduler.heap[last];
+        if (index > 0 && entry_before(&n64scheduler.heap[index], &n64scheduler.heap[(index - 1) / 2])) {
+            sift_up(index);
+        } else {
+            sift_down(index);
+        }
+    }
+    update_next_event_time();
+}
 
-    if (event_occurred) {
-        *event = n64scheduler.scheduler_list->event;
-        free_event_node(n64scheduler.scheduler_list);
-        n64scheduler.scheduler_list = n64scheduler.scheduler_list->next;
+void scheduler_reset() {
+    n64scheduler.scheduler_ticks = 0;
+    n64scheduler.next_sequence = 0;
+    n64scheduler.heap_size = 0;
+    if (n64scheduler.heap == NULL) {
+        n64scheduler.heap_capacity = INITIAL_HEAP_CAPACITY;
+        n64scheduler.heap = malloc(n64scheduler.heap_capacity * sizeof(scheduler_heap_entry_t));
     }
+    update_next_event_time();
+}
 
-    return event_occurred;
+void scheduler_pop_event(scheduler_event_t* event) {
+    *event = n64scheduler.heap[0].event;
+    remove_at(0);
 }
 
 void scheduler_enqueue_absolute(u64 at_ticks, scheduler_event_type_t event_type) {
-    scheduler_event_node_t* ins = alloc_event_node();
-    ins->next = NULL;
-    ins->event.type = event_type;
-    ins->event.time = at_ticks;
-
-    // special case when list is empty
-    if (n64scheduler.scheduler_list == NULL) {
-        n64scheduler.scheduler_list = ins;
-    } else if (at_ticks < n64scheduler.scheduler_list->event.time) {
-        // Special case - inserting at the head of the list
-        ins->next = n64scheduler.scheduler_list;
-        n64scheduler.scheduler_list = ins;
-    } else {
-        // Find the first node with a rank smaller than the node we're inserting
-        // that either has a null next node OR a next node with a larger rank than the one we're inserting.
-
-        scheduler_event_node_t* n = n64scheduler.scheduler_list;
-        while (n->next != NULL && n->next->event.time < at_ticks) {
-            n = n->next;
+    if (n64scheduler.heap_size == n64scheduler.heap_capacity) {
+        n64scheduler.heap_capacity = n64scheduler.heap_capacity ? n64scheduler.heap_capacity * 2 : INITIAL_HEAP_CAPACITY;
+        n64scheduler.heap = realloc(n64scheduler.heap, n64scheduler.heap_capacity * sizeof(scheduler_heap_entry_t));
+        if (n64scheduler.heap == NULL) {
+            logfatal("Unable to grow the scheduler heap to %d events!", n64scheduler.heap_capacity);
         }
-        scheduler_event_node_t* old_next = n->next;
-        n->next = ins;
-        ins->next = old_next;
     }
+
+    int index = n64scheduler.heap_size++;
+    n64scheduler.heap[index].event.type = event_type;
+    n64scheduler.heap[index].event.time = at_ticks;
+    n64scheduler.heap[index].sequence = n64scheduler.next_sequence++;
+    sift_up(index);
+    update_next_event_time();
 }
 
 void scheduler_enqueue_relative(u64 in_ticks, scheduler_event_type_t event_type) {
     scheduler_enqueue_absolute(n64scheduler.scheduler_ticks + in_ticks, event_type);
 }
 
+// There are only ever a handful of events queued, so finding one by type is a short scan. Removing it is O(log n).
 u64 scheduler_remove_event(scheduler_event_type_t event_type) {
-    scheduler_event_node_t* node = n64scheduler.scheduler_list;
-    scheduler_event_node_t** prev_next = &n64scheduler.scheduler_list;
-
-    while (node != NULL) {
-        if (node->event.type == event_type) {
-            u64 in_cycles = node->event.time - n64scheduler.scheduler_ticks;
-            *prev_next = node->next;
-            free_event_node(node);
-            return in_cycles;
+    int found = -1;
+    for (int i = 0; i < n64scheduler.heap_size; i++) {
+        if (n64scheduler.heap[i].event.type == event_type &&
+            (found < 0 || entry_before(&n64scheduler.heap[i], &n64scheduler.heap[found]))) {
+            found = i;
         }
+    }
 
-        prev_next = &node->next;
-        node = node->next;
+    if (found < 0) {
+        return 0;
     }
-    return 0;
-}
\ No newline at end of file
+
+    u64 in_cycles = n64scheduler.heap[found].event.time - n64scheduler.scheduler_ticks;
+    remove_at(found);
+    return in_cycles;
+}
@@ -8,7 +8,9 @@ typedef enum scheduler_event_type {
     SCHEDULER_SI_DMA_COMPLETE,
     SCHEDULER_PI_DMA_COMPLETE,
     SCHEDULER_PI_BUS_WRITE_COMPLETE,
-    SCHEDULER_VI_HALFLINE,
+    SCHEDULER_VI_INTERRUPT,
+    SCHEDULER_VI_FIELD_COMPLETE,
+    SCHEDULER_RSP_SYNC,
     SCHEDULER_RESET_SYSTEM,
     SCHEDULER_COMPARE_INTERRUPT,
     SCHEDULER_HANDLE_INTERRUPT
@@ -19,26 +21,48 @@ typedef struct scheduler_event {
     scheduler_event_type_t type;
 } scheduler_event_t;
 
-#define NUM_EVENT_NODES 10
-typedef struct scheduler_event_node {
+typedef struct scheduler_heap_entry {
     scheduler_event_t event;
-    struct scheduler_event_node* next;
-} scheduler_event_node_t;
+    // Breaks ties between events at the same time, so they fire in the order they were enqueued
+    u64 sequence;
+} scheduler_heap_entry_t;
 
 typedef struct scheduler {
     u64 scheduler_ticks;
-    scheduler_event_node_t event_nodes[NUM_EVENT_NODES];
-    int free_event_nodes_stack_ptr;
-    scheduler_event_node_t* free_event_nodes[NUM_EVENT_NODES];
-    scheduler_event_node_t* scheduler_list;
+    // Time of the event at the top of the heap, or UINT64_MAX if there is none.
+    u64 next_event_time;
+    u64 next_sequence;
+    // Min-heap ordered by time, grows as needed
+    scheduler_heap_entry_t* heap;
+    int heap_size;
+    int heap_capacity;
 } scheduler_t;
 
 extern scheduler_t n64scheduler;
 
 void scheduler_reset();
-bool scheduler_tick(u64 cycles, scheduler_event_t* event);
+void scheduler_pop_event(scheduler_event_t* event);
 u64 scheduler_remove_event(scheduler_event_type_t event_type);
 void scheduler_enqueue_absolute(u64 at_cycles, scheduler_event_type_t event_type);
 void scheduler_enqueue_relative(u64 in_cycles, scheduler_event_type_t event_type);
 
+INLINE bool scheduler_tick(u64 ticks, scheduler_event_t* event) {
+    n64scheduler.scheduler_ticks += ticks;
+
+    if (likely(n64scheduler.scheduler_ticks <= n64scheduler.next_event_time)) {
+        return false;
+    }
+
+    scheduler_pop_event(event);
+    return true;
+}
+
+// How many ticks can pass before scheduler_tick() will return an event.
+INLINE u64 scheduler_ticks_until_next_event() {
+    if (n64scheduler.scheduler_ticks > n64scheduler.next_event_time) {
+        return 0;
+    }
+    return n64scheduler.next_event_time - n64scheduler.scheduler_ticks;
+}
+
 #endif //N64_SCHEDULER_H
@@ -38,6 +38,11 @@ typedef struct rsp_testable_instruction {
     bool random_vs;
 } rsp_testable_instruction_t;
 
+// Picked for the host CPU by rsp_vector_init(), so it can't go in the table directly
+static void fuzz_vmadn(mips_instruction_t instruction) {
+    rsp_vec_vmadn(instruction);
+}
+
 #define INSTR(_handler, _funct, _name, _random_vs) { .handler = _handler, .funct = _funct, .name = _name, .random_vs = _random_vs}
 
 rsp_testable_instruction_t instrs[] = {
@@ -58,7 +63,7 @@ rsp_testable_instruction_t instrs[] = {
         INSTR(rsp_vec_vmadh, FUNCT_RSP_VEC_VMADH, "vmadh", false),
         INSTR(rsp_vec_vmadl, FUNCT_RSP_VEC_VMADL, "vmadl", false),
         INSTR(rsp_vec_vmadm, FUNCT_RSP_VEC_VMADM, "vmadm", false),
-        INSTR(rsp_vec_vmadn, FUNCT_RSP_VEC_VMADN, "vmadn", false),
+        INSTR(fuzz_vmadn, FUNCT_RSP_VEC_VMADN, "vmadn", false),
         INSTR(rsp_vec_vmov, FUNCT_RSP_VEC_VMOV, "vmov", true),
         INSTR(rsp_vec_vmrg, FUNCT_RSP_VEC_VMRG, "vmrg", false),
         INSTR(rsp_vec_vmudh, FUNCT_RSP_VEC_VMUDH, "vmudh", false),
@@ -363,6 +368,7 @@ void init_state_from_hw(rsp_t* rsp) {
 
 int main(int argc, char** argv) {
     memset(&rsp, 0, sizeof(rsp_t));
+    rsp_vector_init();
     srand(time(NULL));
     if (FT_CreateDeviceInfoList(&num_devices) != FT_OK) {
         logdie("Unable to enumerate num_devices. Try again?");
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+#include <system/n64system.h>
+#include <cpu/rsp.h>
+#include <cpu/rsp_audio_hle.h>
+#include <mem/mem_util.h>
+
+// Runs an audio task dumped with --dump-audio-tasks on the RSP, then again with HLE, and compares what both wrote
+// to the output buffers.
+
+// Just to make sure we don't get caught in an infinite loop
+#define MAX_STEPS 50000000
+#define MAX_SAVES 256
+#define SKIP_TEST 77
+
+#define DUMP_HEADER_SIZE 8
+#define DUMP_SIZE (DUMP_HEADER_SIZE + N64_RDRAM_SIZE + SP_DMEM_SIZE + SP_IMEM_SIZE)
+
+u8* load_dump(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        logfatal("Unable to open %s", path);
+    }
+    u8* dump = malloc(DUMP_SIZE);
+    size_t read = fread(dump, 1, DUMP_SIZE, f);
+    fclose(f);
+
+    if (read != DUMP_SIZE || word_from_byte_array(dump, 0) != RSP_AUDIO_HLE_DUMP_MAGIC) {
+        logfatal("%s is not an audio task dump", path);
+    }
+    return dump;
+}
+
+void restore_dump(const u8* dump) {
+    const u8* p = dump + DUMP_HEADER_SIZE;
+    memcpy(n64sys.mem.rdram, p, N64_RDRAM_SIZE);
+    p += N64_RDRAM_SIZE;
+    memcpy(N64RSP.sp_dmem, p, SP_DMEM_SIZE);
+    p += SP_DMEM_SIZE;
+    memcpy(N64RSP.sp_imem, p, SP_IMEM_SIZE);
+
+    for (int i = 0; i < SP_IMEM_SIZE / 4; i++) {
+        N64RSP.icache[i].instruction.raw = word_from_byte_array(N64RSP.sp_imem, i * 4);
+        N64RSP.icache[i].handler = cache_rsp_instruction;
+    }
+
+    N64RSP.status.raw = 0;
+    N64RSP.pc = (word_from_byte_array((u8*)dump, 4) & 0xFFF) >> 2;
+    N64RSP.next_pc = N64RSP.pc + 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        logfatal("Usage: %s <audio task dump>", argv[0]);
+    }
+
+    init_n64system(NULL, false, false, UNKNOWN_VIDEO_TYPE, false);
+    u8* dump = load_dump(argv[1]);
+
+    restore_dump(dump);
+    int steps = 0;
+    while (!N64RSP.status.halt) {
+        if (steps++ >= MAX_STEPS) {
+            logfatal("Task ran too long and was killed! Possible infinite loop?");
+        }
+        rsp_step();
+    }
+    u8* lle_rdram = malloc(N64_RDRAM_SIZE);
+    memcpy(lle_rdram, n64sys.mem.rdram, N64_RDRAM_SIZE);
+
+    restore_dump(dump);
+    rsp_audio_hle_range_t saves[MAX_SAVES];
+    int num_saves = 0;
+    rsp_audio_hle_log_saves(saves, &num_saves, MAX_SAVES);
+    if (!rsp_audio_hle_run_task()) {
+        printf("Not a supported audio task, skipping\n");
+        return SKIP_TEST;
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < num_saves; i++) {
+        for (u32 offset = 0; offset < saves[i].length; offset += 2) {
+            u32 address = saves[i].address + offset;
+            u16 expected = half_from_byte_array(lle_rdram, HALF_ADDRESS(address));
+            u16 actual = half_from_byte_array(n64sys.mem.rdram, HALF_ADDRESS(address));
+            if (expected != actual) {
+                if (mismatches < 16) {
+                    printf("0x%08X: expected %04X, got " COLOR_RED "%04X" COLOR_END "\n", address, expected, actual);
+                }
+                mismatches++;
+            }
+        }
+    }
+
+    printf("%d buffers compared, %d samples differ\n", num_saves, mismatches);
+    free(lle_rdram);
+    free(dump);
+
+    if (num_saves == 0 || mismatches != 0) {
+        logfatal("Tests failed!");
+    }
+    printf("Passed!\n");
+}
@@ -0,0 +1,246 @@
+#include <string.h>
+#include <system/n64system.h>
+#include <cpu/rsp.h>
+#include <cpu/rsp_audio_hle.h>
+#include <mem/mem_util.h>
+
+// Runs short audio command lists through HLE and checks the buffers against output worked out by hand, so the
+// commands are covered without a dumped task. The task looks like ABI1 to HLE, but there's no microcode behind it.
+
+#define AUDIO_DMEM_BASE 0x5C0
+
+#define UCODE_DATA    0x100000
+#define COMMAND_LIST  0x110000
+#define ADPCM_TABLE   0x120000
+#define STATE_ADDRESS 0x130000
+
+#define A_INIT 0x01
+#define A_LEFT 0x02
+#define A_VOL  0x04
+#define A_AUX  0x08
+
+#define ARRAY_LEN(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+int tests_failed = 0;
+
+void report(bool ok, const char* name) {
+    if (ok) {
+        printf(COLOR_GREEN "[PASSED] %s\n" COLOR_END, name);
+    } else {
+        printf(COLOR_RED "[FAILED] %s\n" COLOR_END, name);
+        tests_failed++;
+    }
+}
+
+void set_dmem_s16(u16 offset, s16 value) {
+    half_to_byte_array(N64RSP.sp_dmem, HALF_ADDRESS(AUDIO_DMEM_BASE + offset), value);
+}
+
+s16 get_dmem_s16(u16 offset) {
+    return half_from_byte_array(N64RSP.sp_dmem, HALF_ADDRESS(AUDIO_DMEM_BASE + offset));
+}
+
+void set_rdram_s16(u32 address, s16 value) {
+    half_to_byte_array(n64sys.mem.rdram, HALF_ADDRESS(address), value);
+}
+
+s16 get_rdram_s16(u32 address) {
+    return half_from_byte_array(n64sys.mem.rdram, HALF_ADDRESS(address));
+}
+
+void setup_ucode_data() {
+    memset(n64sys.mem.rdram + UCODE_DATA, 0, SP_DMEM_SIZE);
+    RDRAM_WORD(UCODE_DATA + 0x00) = 0x00000001;
+    RDRAM_WORD(UCODE_DATA + 0x28) = 0x1E24138C;
+    RDRAM_WORD(UCODE_DATA + 0x30) = 0xF0000F00;
+
+    // Only the first phase of the resample filter is filled in, the tests resample at a pitch of exactly 1.
+    const s16 first_row[] = { 0x0C39, 0x66AD, 0x0D46, (s16)0xFFDF };
+    for (int i = 0; i < 4; i++) {
+        set_rdram_s16(UCODE_DATA + 0x100 + i * 2, first_row[i]);
+    }
+}
+
+void run_commands(const char* name, const u32* commands, int num_words) {
+    for (int i = 0; i < num_words; i++) {
+        RDRAM_WORD(COMMAND_LIST + i * 4) = commands[i];
+    }
+
+    word_to_byte_array(N64RSP.sp_dmem, RSP_TASK_TYPE, RSP_TASK_TYPE_AUDIO);
+    word_to_byte_array(N64RSP.sp_dmem, RSP_TASK_UCODE_DATA, UCODE_DATA);
+    word_to_byte_array(N64RSP.sp_dmem, RSP_TASK_DATA_PTR, COMMAND_LIST);
+    word_to_byte_array(N64RSP.sp_dmem, RSP_TASK_DATA_SIZE, num_words * 4);
+    N64RSP.status.raw = 0;
+
+    if (!rsp_audio_hle_run_task()) {
+        report(false, name);
+    }
+}
+
+void check_dmem(const char* name, u16 offset, const s16* expected, int count) {
+    int mismatches = 0;
+    for (int i = 0; i < count; i++) {
+        s16 actual = get_dmem_s16(offset + i * 2);
+        if (actual != expected[i]) {
+            printf("%s: sample %d expected %d, got " COLOR_RED "%d" COLOR_END "\n", name, i, expected[i], actual);
+            mismatches++;
+        }
+    }
+    report(mismatches == 0, name);
+}
+
+void check_rdram_word(const char* name, u32 address, u32 expected) {
+    u32 actual = RDRAM_WORD(address);
+    if (actual != expected) {
+        printf("%s: expected 0x%08X, got " COLOR_RED "0x%08X" COLOR_END "\n", name, expected, actual);
+    }
+    report(actual == expected, name);
+}
+
+void test_mixer() {
+    const s16 in[]  = { 0, 1, -1, 2, -2, 100, -100, 1000, -1000, 32767, -32768, 20000, -20000, 12345, -12345, 7 };
+    const s16 out[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 32767, -32768, 20000, -20000, 0, 0, 0 };
+    // out + in * 0.75, rounded down and saturated
+    const s16 expected[] = { 0, 0, -1, 1, -2, 75, -75, 750, -750, 32767, -32768, 32767, -32768, 9258, -9259, 5 };
+
+    for (int i = 0; i < ARRAY_LEN(in); i++) {
+        set_dmem_s16(0x000 + i * 2, in[i]);
+        set_dmem_s16(0x100 + i * 2, out[i]);
+    }
+
+    const u32 commands[] = {
+            0x08000000, 0x01000020, // SETBUFF in 0x000, out 0x100, 32 bytes
+            0x0C006000, 0x00000100, // MIXER 0x000 into 0x100, gain 0x6000
+    };
+    run_commands("MIXER", commands, ARRAY_LEN(commands));
+    check_dmem("MIXER", 0x100, expected, ARRAY_LEN(expected));
+}
+
+void test_adpcm() {
+    // Predicts from the previous sample at half weight: book1 is 0.5 everywhere and book2 is zero.
+    for (int i = 0; i < 8; i++) {
+        set_rdram_s16(ADPCM_TABLE + i * 2, 0x0400);
+        set_rdram_s16(ADPCM_TABLE + 16 + i * 2, 0);
+    }
+
+    // Scale 9 with codebook 0, so each nibble is worth 512.
+    const u8 frame[] = { 0x90, 0x12, 0x34, 0x56, 0x7F, 0xED, 0xCB, 0xA9, 0x80 };
+    for (int i = 0; i < ARRAY_LEN(frame); i++) {
+        N64RSP.sp_dmem[BYTE_ADDRESS(AUDIO_DMEM_BASE + i)] = frame[i];
+    }
+
+    // The first half starts from a cleared history and is just the nibbles. The second half adds half of the 7th
+    // sample of the first, 3584 / 2.
+    const s16 expected[] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            512, 1024, 1536, 2048, 2560, 3072, 3584, -512,
+            -1024 + 1792, -1536 + 1792, -2048 + 1792, -2560 + 1792, -3072 + 1792, -3584 + 1792, -4096 + 1792, 0 + 1792,
+    };
+
+    const u32 commands[] = {
+            0x0B000020, ADPCM_TABLE,   // LOADADPCM 32 bytes
+            0x08000000, 0x01000020,    // SETBUFF in 0x000, out 0x100, 32 bytes
+            0x01010000, STATE_ADDRESS, // ADPCM init
+    };
+    run_commands("ADPCM", commands, ARRAY_LEN(commands));
+    check_dmem("ADPCM", 0x100, expected, ARRAY_LEN(expected));
+
+    bool state_matches = true;
+    for (int i = 0; i < 16; i++) {
+        state_matches &= get_rdram_s16(STATE_ADDRESS + i * 2) == expected[16 + i];
+    }
+    report(state_matches, "ADPCM saves the last frame");
+}
+
+void test_resample() {
+    const s16 in[] = { 0x1000, 0x2000, 0x3000, 0x4000, -0x4000, 0, 0x7FFF, -0x8000 };
+    // Four taps of the first filter phase over the input, starting from four cleared samples
+    const s16 expected[] = { 0, -5, 416, 4122, 8220, 12354, 12616, -11611 };
+
+    for (int i = 0; i < ARRAY_LEN(in); i++) {
+        set_dmem_s16(0x010 + i * 2, in[i]);
+    }
+
+    const u32 commands[] = {
+            0x08000010, 0x01000010,    // SETBUFF in 0x010, out 0x100, 16 bytes
+            0x05018000, STATE_ADDRESS, // RESAMPLE init, pitch 1
+    };
+    run_commands("RESAMPLE", commands, ARRAY_LEN(commands));
+    check_dmem("RESAMPLE", 0x100, expected, ARRAY_LEN(expected));
+
+    // The last four input samples are kept for the next call, then the pitch accumulator
+    bool state_matches = get_rdram_s16(STATE_ADDRESS + 8) == 0;
+    for (int i = 0; i < 4; i++) {
+        state_matches &= get_rdram_s16(STATE_ADDRESS + i * 2) == in[4 + i];
+    }
+    report(state_matches, "RESAMPLE saves its state");
+}
+
+void test_envmixer() {
+    const s16 in[] = { 400, -400, 1000, -1000, 32767, -32768, 0, 4, 8, -8, 12, -12, 16, -16, 20, -20 };
+    // Constant volumes of 0.5 on the left and 0.25 on the right, all dry
+    s16 left[ARRAY_LEN(in)];
+    s16 right[ARRAY_LEN(in)];
+    const s16 half[] = { 200, -200, 500, -500, 16383, -16384, 0, 2, 4, -4, 6, -6, 8, -8, 10, -10 };
+    const s16 quarter[] = { 100, -100, 250, -250, 8191, -8192, 0, 1, 2, -2, 3, -3, 4, -4, 5, -5 };
+
+    for (int i = 0; i < ARRAY_LEN(in); i++) {
+        set_dmem_s16(0x000 + i * 2, in[i]);
+        set_dmem_s16(0x100 + i * 2, 0);
+        set_dmem_s16(0x200 + i * 2, 0);
+    }
+
+    const u32 setup[] = {
+            0x08000000, 0x01000020,                    // SETBUFF in 0x000, out 0x100, 32 bytes
+            0x08080200, 0x03000400,                    // SETBUFF aux dry right 0x200
+            0x09080000 | 0x7FFF, 0x00000000,           // SETVOL dry 0x7FFF, wet 0
+            0x09000000 | ((A_LEFT | A_VOL) << 16) | 0x4000, 0x00000000,
+            0x09000000 | (A_VOL << 16) | 0x2000, 0x00000000,
+            0x09000000 | (A_LEFT << 16) | 0x4000, 0x00010000, // Targets same as the volumes
+            0x09000000 | 0x2000, 0x00010000,
+            0x03010000, STATE_ADDRESS,                 // ENVMIXER init
+    };
+    run_commands("ENVMIXER init", setup, ARRAY_LEN(setup));
+    check_dmem("ENVMIXER init left", 0x100, half, ARRAY_LEN(half));
+    check_dmem("ENVMIXER init right", 0x200, quarter, ARRAY_LEN(quarter));
+
+    // Big endian, at the offsets the microcode's buffer is read from
+    check_rdram_word("ENVMIXER state wet and dry", STATE_ADDRESS + 0x00, 0x00007FFF);
+    check_rdram_word("ENVMIXER state left target", STATE_ADDRESS + 0x04, 0x40000000);
+    check_rdram_word("ENVMIXER state right target", STATE_ADDRESS + 0x08, 0x20000000);
+    check_rdram_word("ENVMIXER state left rate", STATE_ADDRESS + 0x0C, 0x00010000);
+    check_rdram_word("ENVMIXER state right rate", STATE_ADDRESS + 0x10, 0x00010000);
+    check_rdram_word("ENVMIXER state left volume", STATE_ADDRESS + 0x1C, 0x40000000);
+    check_rdram_word("ENVMIXER state right volume", STATE_ADDRESS + 0x20, 0x20000000);
+
+    // Picking the voice back up from the saved state mixes the same again on top. The volumes set up above are
+    // cleared first, so they can only come from the state.
+    const u32 resume[] = {
+            0x09080000, 0x00000000,
+            0x09000000 | ((A_LEFT | A_VOL) << 16), 0x00000000,
+            0x09000000 | (A_VOL << 16), 0x00000000,
+            0x03000000, STATE_ADDRESS, // ENVMIXER
+    };
+    for (int i = 0; i < ARRAY_LEN(in); i++) {
+        left[i] = half[i] * 2;
+        right[i] = quarter[i] * 2;
+    }
+    run_commands("ENVMIXER resume", resume, ARRAY_LEN(resume));
+    check_dmem("ENVMIXER resume left", 0x100, left, ARRAY_LEN(left));
+    check_dmem("ENVMIXER resume right", 0x200, right, ARRAY_LEN(right));
+}
+
+int main(int argc, char** argv) {
+    init_n64system(NULL, false, false, UNKNOWN_VIDEO_TYPE, false);
+    setup_ucode_data();
+
+    test_mixer();
+    test_adpcm();
+    test_resample();
+    test_envmixer();
+
+    if (tests_failed > 0) {
+        logfatal("%d tests failed!", tests_failed);
+    }
+    printf("Passed!\n");
+}
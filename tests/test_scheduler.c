@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <log.h>
+#include <system/scheduler.h>
+
+// Ticks until the next event fires, and returns it.
+scheduler_event_t next_event() {
+    scheduler_event_t event;
+    while (!scheduler_tick(1, &event)) {}
+    return event;
+}
+
+int main(int argc, char** argv) {
+    int tests_failed = 0;
+    scheduler_reset();
+
+    // More events than the old fixed node pool could hold, in scrambled order
+    const int num_events = 64;
+    for (int i = 0; i < num_events; i++) {
+        u64 time = 100 + ((i * 37) % num_events) * 10;
+        scheduler_enqueue_absolute(time, (scheduler_event_type_t)((time / 10) % (SCHEDULER_HANDLE_INTERRUPT + 1)));
+    }
+
+    if (scheduler_ticks_until_next_event() != 100) {
+        printf(COLOR_RED "[FAILED] Expected 100 ticks until the next event, got %" PRIu64 "\n" COLOR_END, scheduler_ticks_until_next_event());
+        tests_failed++;
+    }
+
+    u64 last_time = 0;
+    for (int i = 0; i < num_events; i++) {
+        scheduler_event_t event = next_event();
+        if (event.time < last_time || n64scheduler.scheduler_ticks != event.time + 1) {
+            printf(COLOR_RED "[FAILED] Event %d at %" PRIu64 " fired at tick %" PRIu64 " after an event at %" PRIu64 "\n" COLOR_END,
+                   i, event.time, n64scheduler.scheduler_ticks, last_time);
+            tests_failed++;
+        }
+        last_time = event.time;
+    }
+
+    // Events at the same time fire in the order they were enqueued, and removing one doesn't disturb the rest
+    scheduler_reset();
+    scheduler_enqueue_relative(50, SCHEDULER_VI_FIELD_COMPLETE);
+    scheduler_enqueue_relative(10, SCHEDULER_SI_DMA_COMPLETE);
+    scheduler_enqueue_relative(10, SCHEDULER_PI_DMA_COMPLETE);
+    scheduler_enqueue_relative(20, SCHEDULER_COMPARE_INTERRUPT);
+    scheduler_enqueue_relative(10, SCHEDULER_HANDLE_INTERRUPT);
+
+    u64 removed_in = scheduler_remove_event(SCHEDULER_COMPARE_INTERRUPT);
+    if (removed_in != 20) {
+        printf(COLOR_RED "[FAILED] Removed event was due in %" PRIu64 " ticks, expected 20\n" COLOR_END, removed_in);
+        tests_failed++;
+    }
+    if (scheduler_remove_event(SCHEDULER_COMPARE_INTERRUPT) != 0) {
+        printf(COLOR_RED "[FAILED] Removed an event that was no longer queued\n" COLOR_END);
+        tests_failed++;
+    }
+
+    scheduler_event_type_t expected[] = { SCHEDULER_SI_DMA_COMPLETE, SCHEDULER_PI_DMA_COMPLETE, SCHEDULER_HANDLE_INTERRUPT, SCHEDULER_VI_FIELD_COMPLETE };
+    for (int i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        scheduler_event_t event = next_event();
+        if (event.type != expected[i]) {
+            printf(COLOR_RED "[FAILED] Event %d had type %d, expected %d\n" COLOR_END, i, event.type, expected[i]);
+            tests_failed++;
+        }
+    }
+
+    if (scheduler_ticks_until_next_event() != UINT64_MAX - n64scheduler.scheduler_ticks) {
+        printf(COLOR_RED "[FAILED] Scheduler should be empty\n" COLOR_END);
+        tests_failed++;
+    }
+
+    if (tests_failed == 0) {
+        printf(COLOR_GREEN "[PASSED] scheduler\n" COLOR_END);
+    }
+    return tests_failed != 0;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <util.h>
+#include <log.h>
+#include <mem/n64mem.h>
+#include <mem/mem_util.h>
+#include <rdp/softrdp.h>
+
+// Draws random fill rectangles in fill mode and in 1-cycle mode with random blender settings, at 16 and 32bpp, and
+// checks every pixel of the color image against the color worked out from the blender formula.
+
+#define NUM_RECTANGLES 4000
+
+#define COLOR_IMAGE 0x100000
+#define WIDTH       64
+#define HEIGHT      64
+
+#define CYCLE_TYPE_1CYCLE 0
+#define CYCLE_TYPE_FILL   3
+
+static softrdp_state_t rdp;
+static u8 rdram[N64_RDRAM_SIZE];
+static u32 expected[HEIGHT][WIDTH];
+
+static u64 rng = 99;
+
+u64 next_random() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+void send_one(u64 command) {
+    u32 words[2] = { command >> 32, command };
+    softrdp_enqueue_command(&rdp, 2, words);
+}
+
+u32 get_pixel(int size, int x, int y) {
+    if (size == 2) {
+        return half_from_byte_array(rdram, HALF_ADDRESS(COLOR_IMAGE + (y * WIDTH + x) * 2));
+    } else {
+        return word_from_byte_array(rdram, WORD_ADDRESS(COLOR_IMAGE + (y * WIDTH + x) * 4));
+    }
+}
+
+u8 channel(u32 color, int shift) {
+    return color >> shift;
+}
+
+// What the fill pattern feeds the blender: the pixel is white and memory isn't read
+u32 blender_color_input(int source, u32 blend_color, u32 fog_color) {
+    switch (source) {
+        case 0: return 0xFFFFFFFF;
+        case 1: return 0;
+        case 2: return blend_color;
+        default: return fog_color;
+    }
+}
+
+// 1a * 1b + 2a * 2b with both alphas cut to 5 bits, the pixel alpha passing through
+u32 expected_1cycle(u64 other_modes, u32 blend_color, u32 fog_color) {
+    u32 color_1a = blender_color_input((other_modes >> 30) & 3, blend_color, fog_color);
+    if (!((other_modes >> 14) & 1)) {
+        // Without force_blend there are no edge pixels to blend
+        return color_1a;
+    }
+    const u8 alphas_1b[4] = { 0xFF, channel(fog_color, 0), 0xFF, 0 };
+    u8 alpha_1b = alphas_1b[(other_modes >> 26) & 3];
+    const u8 alphas_2b[4] = { 0xFF - alpha_1b, 0, 0xFF, 0 };
+    u8 alpha_2b = alphas_2b[(other_modes >> 18) & 3];
+    u32 color_2a = blender_color_input((other_modes >> 22) & 3, blend_color, fog_color);
+
+    int a = alpha_1b >> 3;
+    int b = (alpha_2b >> 3) + 1;
+    u32 result = 0xFF;
+    for (int shift = 8; shift < 32; shift += 8) {
+        int value = (channel(color_1a, shift) * a + channel(color_2a, shift) * b) >> 5;
+        result |= (u32)(value > 0xFF ? 0xFF : value) << shift;
+    }
+    return result;
+}
+
+u16 to_16bpp(u32 color) {
+    return (channel(color, 24) >> 3) << 11 | (channel(color, 16) >> 3) << 6 | (channel(color, 8) >> 3) << 1 | 1;
+}
+
+int main(int argc, char** argv) {
+    softrdp_init(&rdp, rdram);
+
+    for (int rectangle = 0; rectangle < NUM_RECTANGLES; rectangle++) {
+        int size = next_random() & 1 ? 2 : 3;
+        send_one((u64)0x3F << 56 | (u64)size << 51 | (u64)(WIDTH - 1) << 32 | COLOR_IMAGE);
+
+        // Random blender settings for both cycles and a random force_blend
+        int cycle_type = next_random() % 4 == 0 ? CYCLE_TYPE_FILL : CYCLE_TYPE_1CYCLE;
+        u64 other_modes = (u64)0x2F << 56 | (u64)cycle_type << 52 | (next_random() & 0xFFFF0000) | (next_random() & (1 << 14));
+        send_one(other_modes);
+        u32 blend_color = next_random();
+        u32 fog_color = next_random();
+        u32 fill_color = next_random();
+        send_one((u64)0x39 << 56 | blend_color);
+        send_one((u64)0x38 << 56 | fog_color);
+        send_one((u64)0x37 << 56 | fill_color);
+
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                expected[y][x] = get_pixel(size, x, y);
+            }
+        }
+
+        // X is inclusive at both ends, Y stops before the bottom edge
+        int x0 = next_random() % 32, y0 = next_random() % 32;
+        int x1 = x0 + next_random() % 32, y1 = y0 + next_random() % 32;
+        send_one((u64)0x36 << 56 | (u64)(x1 * 4) << 44 | (u64)(y1 * 4) << 32 | (x0 * 4) << 12 | (y0 * 4));
+        softrdp_flush(&rdp);
+
+        u32 color = cycle_type == CYCLE_TYPE_FILL ? fill_color : expected_1cycle(other_modes, blend_color, fog_color);
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                if (size == 3) {
+                    expected[y][x] = color;
+                } else if (cycle_type == CYCLE_TYPE_FILL) {
+                    // The fill color holds two pixels, the left one in the upper half
+                    expected[y][x] = x & 1 ? color & 0xFFFF : color >> 16;
+                } else {
+                    expected[y][x] = to_16bpp(color);
+                }
+            }
+        }
+
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                if (get_pixel(size, x, y) != expected[y][x]) {
+                    logfatal("[FAILED] Rectangle %d, %dbpp %s with other modes 0x%016llX: pixel (%d, %d) is 0x%08X, expected 0x%08X",
+                             rectangle, size == 2 ? 16 : 32, cycle_type == CYCLE_TYPE_FILL ? "fill" : "1-cycle",
+                             (unsigned long long)other_modes, x, y, get_pixel(size, x, y), expected[y][x]);
+                }
+            }
+        }
+    }
+    printf("Passed!\n");
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include <util.h>
+#include <log.h>
+#include <mem/n64mem.h>
+#include <mem/mem_util.h>
+#include <rdp/softrdp.h>
+
+// Draws the same random primitives with the software RDP on the emulation thread, on its own thread, and on its own
+// thread with band workers, and checks all three leave the same bytes in RDRAM whenever they're flushed.
+
+#define NUM_PRIMITIVES 3000
+#define FLUSH_EVERY 100
+
+#define COLOR_IMAGE   0x100000
+#define WIDTH         320
+#define HEIGHT        240
+#define TEXTURE_DATA  0x200000
+
+#define NUM_RDPS 3
+
+static const char* rdp_names[NUM_RDPS] = { "synchronous", "threaded", "threaded with workers" };
+static softrdp_state_t rdps[NUM_RDPS];
+static u8 rdrams[NUM_RDPS][N64_RDRAM_SIZE];
+
+static u64 rng = 12345;
+
+u64 next_random() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+void send(const u64* commands, int num_commands) {
+    u32 words[44];
+    for (int i = 0; i < num_commands; i++) {
+        words[i * 2 + 0] = commands[i] >> 32;
+        words[i * 2 + 1] = commands[i];
+    }
+    for (int i = 0; i < NUM_RDPS; i++) {
+        softrdp_enqueue_command(&rdps[i], num_commands * 2, words);
+    }
+}
+
+void send_one(u64 command) {
+    send(&command, 1);
+}
+
+bool framebuffers_match(int primitive) {
+    bool match = true;
+    for (int i = 0; i < NUM_RDPS; i++) {
+        softrdp_flush(&rdps[i]);
+    }
+    for (int i = 1; i < NUM_RDPS; i++) {
+        if (memcmp(rdrams[0] + COLOR_IMAGE, rdrams[i] + COLOR_IMAGE, WIDTH * HEIGHT * 2) != 0) {
+            printf(COLOR_RED "[FAILED] The %s RDP differs from the synchronous one after %d primitives\n" COLOR_END,
+                   rdp_names[i], primitive);
+            match = false;
+        }
+    }
+    return match;
+}
+
+void send_random_tiles() {
+    for (u64 tile = 0; tile < 8; tile++) {
+        u64 set_tile = (u64)0x35 << 56
+                | (next_random() % 5) << 53 | (next_random() % 4) << 51 | (next_random() % 8) << 41
+                | (next_random() % 64) << 32 | tile << 24 | (next_random() % 16) << 20
+                | (next_random() & 1) << 19 | (next_random() & 1) << 18 | (next_random() % 6) << 14
+                | (next_random() & 1) << 9 | (next_random() & 1) << 8 | (next_random() % 6) << 4;
+        u64 set_tile_size = (u64)0x32 << 56 | tile << 24 | ((next_random() % 64) << 2) << 12 | ((next_random() % 64) << 2);
+        send_one(set_tile);
+        send_one(set_tile_size);
+    }
+}
+
+void send_random_triangle() {
+    // Random modes, with Z off since there's no Z buffer
+    u64 other_modes = next_random() & ~((u64)3 << 52) & ~((u64)0x3F << 56);
+    other_modes |= (u64)0x2F << 56 | (next_random() & 1) << 52;
+    other_modes &= ~((u64)1 << 4) & ~((u64)1 << 5) & ~((u64)1 << 2);
+    send_one(other_modes);
+    send_one((next_random() & 0x00FFFFFFFFFFFFFFull) | (u64)0x3C << 56); // Set combine
+    send_one((next_random() & 0xFFFFFFFFFF) | (u64)0x3A << 56);          // Set prim color
+    send_one((next_random() & 0xFFFFFFFF) | (u64)0x3B << 56);            // Set env color
+    send_one((next_random() & 0xFFFFFFFF) | (u64)0x38 << 56);            // Set fog color
+    send_one((next_random() & 0xFFFFFFFF) | (u64)0x39 << 56);            // Set blend color
+
+    // Plain, shaded, textured, or shaded and textured
+    const u64 commands[] = { 0x08, 0x0A, 0x0C, 0x0E };
+    u64 command = commands[next_random() % 4];
+    u64 words[20] = { 0 };
+    u64 yh = next_random() % 100;
+    u64 ym = yh + next_random() % 40;
+    u64 yl = ym + next_random() % 40;
+    words[0] = command << 56 | (next_random() & 1) << 55 | (next_random() % 8) << 48 | (yl * 4) << 32 | (ym * 4) << 16 | (yh * 4);
+    u64 x = 50 + next_random() % 150;
+    for (int i = 1; i < 4; i++) {
+        u64 slope = (u16)((int)(next_random() % 5) - 2);
+        words[i] = x << 48 | (next_random() & 0xFFFF) << 32 | slope << 16 | (next_random() & 0xFFFF);
+    }
+    int num_words = 4;
+    if (command & 4) {
+        for (int i = 0; i < 8; i++) {
+            words[num_words++] = next_random() & 0x00FF00FF00FF00FFull;
+        }
+    }
+    if (command & 2) {
+        for (int i = 0; i < 8; i++) {
+            words[num_words++] = next_random() & 0x03FF03FF03FF03FFull;
+        }
+    }
+    send(words, num_words);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 0; i < NUM_RDPS; i++) {
+        softrdp_init(&rdps[i], rdrams[i]);
+    }
+    softrdp_start_thread(&rdps[1]);
+    softrdp_start_workers(&rdps[2], 4);
+    softrdp_start_thread(&rdps[2]);
+
+    // Random texture data, loaded into all of TMEM with load_block
+    for (int i = 0; i < NUM_RDPS; i++) {
+        for (u32 offset = 0; offset < 0x1000; offset += 4) {
+            rng = 0x9E3779B97F4A7C15ull ^ offset;
+            word_to_byte_array(rdrams[i], TEXTURE_DATA + offset, next_random());
+        }
+    }
+    rng = 12345;
+    send_one((u64)0x3F << 56 | (u64)2 << 51 | (u64)(WIDTH - 1) << 32 | COLOR_IMAGE); // Set color image, 16bpp
+    send_one((u64)0x3D << 56 | (u64)2 << 51 | TEXTURE_DATA);                         // Set texture image, 16bpp
+    send_one((u64)0x35 << 56 | (u64)2 << 51 | (u64)7 << 24);                         // Set tile 7 to TMEM 0
+    send_one((u64)0x33 << 56 | (u64)7 << 24 | (u64)0x7FF << 12);                     // Load block, 2048 texels
+
+    bool passed = true;
+    for (int i = 0; i < NUM_PRIMITIVES && passed; i++) {
+        if (i % FLUSH_EVERY == 0) {
+            send_random_tiles();
+        }
+        send_random_triangle();
+        if ((i + 1) % FLUSH_EVERY == 0) {
+            passed = framebuffers_match(i + 1);
+        }
+    }
+
+    if (!passed) {
+        logfatal("Tests failed!");
+    }
+    printf("Passed!\n");
+}
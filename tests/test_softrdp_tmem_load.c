@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+#include <util.h>
+#include <log.h>
+#include <mem/n64mem.h>
+#include <mem/mem_util.h>
+#include <rdp/softrdp.h>
+
+// Runs random load_tile, load_block and load_tlut commands and checks TMEM against what each should have written,
+// worked out a byte at a time in N64 order. Covers the word copies, the 32bpp RG/BA split and the palette layout.
+
+#define NUM_LOADS 20000
+
+#define TEXEL_SIZE_8  1
+#define TEXEL_SIZE_16 2
+#define TEXEL_SIZE_32 3
+
+static softrdp_state_t rdp;
+static u8 rdram[N64_RDRAM_SIZE];
+static u8 expected[sizeof(rdp.tmem)];
+
+static u64 rng = 777;
+
+u64 next_random() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+void send_one(u64 command) {
+    u32 words[2] = { command >> 32, command };
+    softrdp_enqueue_command(&rdp, 2, words);
+}
+
+u8 rdram_byte(u32 address) {
+    return rdram[BYTE_ADDRESS(address & (N64_RDRAM_SIZE - 1))];
+}
+
+u8* expected_byte(u32 address) {
+    return &expected[BYTE_ADDRESS(address & 0xFFF)];
+}
+
+void expect_half(u32 tmem_address, u16 value) {
+    *expected_byte(tmem_address + 0) = value >> 8;
+    *expected_byte(tmem_address + 1) = value;
+}
+
+void set_texture_image(int size, int width, u32 address) {
+    send_one((u64)0x3D << 56 | (u64)size << 51 | (u64)(width - 1) << 32 | address);
+}
+
+void set_tile(int tile, int size, int line, int tmem_adrs) {
+    send_one((u64)0x35 << 56 | (u64)size << 51 | (u64)line << 41 | (u64)tmem_adrs << 32 | (u64)tile << 24);
+}
+
+// Any alignment for 8bpp, texel aligned for 16bpp, and 64 bit aligned for 32bpp like the hardware needs.
+// Sometimes close enough to the end of RDRAM for a load to wrap around.
+u32 random_texture_address(int size) {
+    u32 address = next_random() % 4 == 0 ? N64_RDRAM_SIZE - next_random() % 2000 : next_random() % 0x700000;
+    if (size == TEXEL_SIZE_32 || next_random() & 1) {
+        address &= ~7;
+    } else if (size == TEXEL_SIZE_16) {
+        address &= ~1;
+    }
+    return address & (N64_RDRAM_SIZE - 1);
+}
+
+void load_tile(int tile) {
+    int size = TEXEL_SIZE_8 + next_random() % 3;
+    int width = 1 + next_random() % 300;
+    u32 dram_base = random_texture_address(size);
+    int line = next_random() % 64;
+    set_texture_image(size, width, dram_base);
+    set_tile(tile, size, line, 0);
+
+    int sl = next_random() % 40;
+    int tl = next_random() % 40;
+    int sh = sl + next_random() % 100;
+    int th = tl + next_random() % 30;
+    send_one((u64)0x34 << 56 | (u64)(sl * 4) << 44 | (u64)(tl * 4) << 32 | (u64)tile << 24 | (sh * 4) << 12 | th * 4);
+
+    const int bytes_per_texel = 1 << (size - 1);
+    for (int t = 0; t <= th - tl; t++) {
+        const u32 tile_line = t * line * 8;
+        const u32 dram_line = dram_base + (t + tl) * width * bytes_per_texel + sl * bytes_per_texel;
+        const u32 tmem_xor = t & 1 ? 4 : 0;
+        for (int s = 0; s <= sh - sl; s++) {
+            if (size == TEXEL_SIZE_32) {
+                // RG goes to the lower half of TMEM, BA to the same place in the upper half
+                const u32 tmem_address = ((tile_line + s * 2) ^ tmem_xor) & 0x7FF;
+                const u32 texel = dram_line + s * 4;
+                expect_half(tmem_address, rdram_byte(texel + 0) << 8 | rdram_byte(texel + 1));
+                expect_half(tmem_address | 0x800, rdram_byte(texel + 2) << 8 | rdram_byte(texel + 3));
+            } else {
+                // 16bpp loads stay in the lower half of TMEM
+                const u32 tmem_mask = size == TEXEL_SIZE_8 ? 0xFFF : 0x7FF;
+                for (int i = 0; i < bytes_per_texel; i++) {
+                    const u32 offset = s * bytes_per_texel + i;
+                    *expected_byte(((tile_line + offset) ^ tmem_xor) & tmem_mask) = rdram_byte(dram_line + offset);
+                }
+            }
+        }
+    }
+}
+
+void load_block(int tile) {
+    u32 dram_base = random_texture_address(TEXEL_SIZE_16);
+    int tmem_adrs = next_random() % 512;
+    set_texture_image(TEXEL_SIZE_16, 1, dram_base);
+    set_tile(tile, TEXEL_SIZE_16, 0, tmem_adrs);
+
+    int sl = next_random() % 64;
+    int sh = sl + next_random() % 1200;
+    int tl = next_random() % 8;
+    // DxT is 1.11 fixed point, kept below 1.0
+    int dxt = next_random() % 0x800;
+    send_one((u64)0x33 << 56 | (u64)sl << 44 | (u64)tl << 32 | (u64)tile << 24 | (u64)sh << 12 | dxt);
+
+    // T goes up by DxT every 64 bit word, and words on odd lines are swapped
+    u32 t = tl << 11;
+    for (int i = 0; i < (sh - sl + 1) * 2; i++) {
+        if ((i & 7) == 0) {
+            t += dxt;
+        }
+        const u32 tmem_xor = (t >> 11) & 1 ? 4 : 0;
+        *expected_byte((tmem_adrs * 8 + sl * 2 + i) ^ tmem_xor) = rdram_byte(dram_base + sl * 2 + i);
+    }
+}
+
+void load_tlut(int tile) {
+    int width = 1 + next_random() % 300;
+    u32 dram_base = random_texture_address(TEXEL_SIZE_16);
+    int tmem_adrs = 256 + next_random() % 256;
+    set_texture_image(TEXEL_SIZE_16, width, dram_base);
+    set_tile(tile, TEXEL_SIZE_16, 0, tmem_adrs);
+
+    int sl = next_random() % 64;
+    int tl = next_random() % 16;
+    int sh = sl + next_random() % 256;
+    send_one((u64)0x30 << 56 | (u64)(sl * 4) << 44 | (u64)(tl * 4) << 32 | (u64)tile << 24 | (u64)(sh * 4) << 12);
+
+    // Each entry fills a whole 64 bit word, written four times over
+    for (int i = 0; i <= sh - sl; i++) {
+        const u32 entry = dram_base + (tl * width + sl + i) * 2;
+        for (int k = 0; k < 4; k++) {
+            expect_half(tmem_adrs * 8 + i * 8 + k * 2, rdram_byte(entry) << 8 | rdram_byte(entry + 1));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    softrdp_init(&rdp, rdram);
+    for (int i = 0; i < N64_RDRAM_SIZE; i++) {
+        rdram[i] = next_random();
+    }
+
+    static const char* load_names[3] = { "load_tile", "load_block", "load_tlut" };
+    for (int load = 0; load < NUM_LOADS; load++) {
+        for (int i = 0; i < sizeof(rdp.tmem); i++) {
+            rdp.tmem[i] = next_random();
+        }
+        memcpy(expected, rdp.tmem, sizeof(expected));
+
+        int kind = next_random() % 3;
+        int tile = next_random() % 8;
+        switch (kind) {
+            case 0: load_tile(tile); break;
+            case 1: load_block(tile); break;
+            case 2: load_tlut(tile); break;
+        }
+
+        for (int i = 0; i < sizeof(expected); i++) {
+            if (rdp.tmem[i] != expected[i]) {
+                logfatal("[FAILED] %s number %d: TMEM byte 0x%03X is 0x%02X, expected 0x%02X",
+                         load_names[kind], load, BYTE_ADDRESS(i), rdp.tmem[i], expected[i]);
+            }
+        }
+    }
+    printf("Passed!\n");
+}
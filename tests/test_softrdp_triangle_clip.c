@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+#include <util.h>
+#include <log.h>
+#include <mem/n64mem.h>
+#include <mem/mem_util.h>
+#include <rdp/softrdp.h>
+
+// Draws triangles hanging off the left and top of the color image, and past the bottom of what a span list can hold,
+// and checks the software RDP draws exactly the part that's on screen.
+
+#define COLOR_IMAGE 0x100000
+#define WIDTH       320
+#define HEIGHT      240
+
+// Nothing is drawn in this color
+#define BACKGROUND  0x5555
+
+#define CYCLE_TYPE_1CYCLE 0
+#define CYCLE_TYPE_FILL   3
+
+static softrdp_state_t rdp;
+static u8 rdram[N64_RDRAM_SIZE];
+
+void send(const u64* commands, int num_commands) {
+    u32 words[44];
+    for (int i = 0; i < num_commands; i++) {
+        words[i * 2 + 0] = commands[i] >> 32;
+        words[i * 2 + 1] = commands[i];
+    }
+    softrdp_enqueue_command(&rdp, num_commands * 2, words);
+}
+
+void send_one(u64 command) {
+    send(&command, 1);
+}
+
+u16 get_pixel(int x, int y) {
+    return half_from_byte_array(rdram, HALF_ADDRESS(COLOR_IMAGE + (y * WIDTH + x) * 2));
+}
+
+void clear_color_image() {
+    softrdp_flush(&rdp);
+    for (int y = 0; y < 1024; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            half_to_byte_array(rdram, HALF_ADDRESS(COLOR_IMAGE + (y * WIDTH + x) * 2), BACKGROUND);
+        }
+    }
+}
+
+void set_cycle_type(int cycle_type) {
+    send_one((u64)0x2F << 56 | (u64)cycle_type << 52);
+}
+
+void set_scissor(int x0, int y0, int x1, int y1) {
+    send_one((u64)0x2D << 56 | (u64)(x0 * 4) << 44 | (u64)(y0 * 4) << 32 | (u64)(x1 * 4) << 12 | (y1 * 4));
+}
+
+u64 edge(int x, int dxdy) {
+    return (u64)(u16)x << 48 | (u64)(u16)dxdy << 16;
+}
+
+// A triangle with vertical edges, so it covers [x_left, x_right) on every scanline in [y_top, y_bottom)
+void send_box_triangle(int command, bool right_major, int x_left, int x_right, int y_top, int y_bottom, const u64* shade) {
+    u64 words[12] = { 0 };
+    words[0] = (u64)command << 56 | (u64)right_major << 55
+            | (u64)((y_bottom * 4) & 0x3FFF) << 32 | (u64)((y_bottom * 4) & 0x3FFF) << 16 | ((y_top * 4) & 0x3FFF);
+    int major = right_major ? x_right : x_left;
+    int minor = right_major ? x_left : x_right;
+    words[1] = edge(minor, 0); // XL
+    words[2] = edge(major, 0); // XH
+    words[3] = edge(minor, 0); // XM
+    int num_words = 4;
+    if (shade) {
+        memcpy(&words[4], shade, 8 * sizeof(u64));
+        num_words += 8;
+    }
+    send(words, num_words);
+}
+
+bool check_box(const char* name, int x0, int x1, int y0, int y1, u16 color) {
+    softrdp_flush(&rdp);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            bool inside = x >= x0 && x < x1 && y >= y0 && y < y1;
+            u16 expected = inside ? color : BACKGROUND;
+            if (get_pixel(x, y) != expected) {
+                printf(COLOR_RED "[FAILED] %s: pixel (%d, %d) is 0x%04X, expected 0x%04X\n" COLOR_END,
+                       name, x, y, get_pixel(x, y), expected);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_box(const char* name, int cycle_type, bool right_major, int x_left, int x_right, int y_top, int y_bottom) {
+    clear_color_image();
+    set_cycle_type(cycle_type);
+    send_box_triangle(0x08, right_major, x_left, x_right, y_top, y_bottom, NULL);
+
+    int x0 = x_left < 0 ? 0 : x_left;
+    int x1 = x_right > WIDTH ? WIDTH : x_right;
+    int y0 = y_top < 0 ? 0 : y_top;
+    int y1 = y_bottom > HEIGHT ? HEIGHT : y_bottom;
+    // Fill mode writes the fill color, one cycle mode the primitive color through the combiner
+    return check_box(name, x0, x1, y0, y1, 0xF801);
+}
+
+// Shade changes down the triangle, so clipping its top off has to step the attributes down to the first drawn line.
+bool test_shade_below_scissor() {
+    // Red starts at 0 and goes up by 1 per scanline, everything else is constant
+    const u64 shade[8] = {
+        (u64)0x00FF << 16 | 0x00FF,     // R, G, B, A
+        0,                              // DrDx, DgDx, DbDx, DaDx
+        0,                              // Fractions
+        0,
+        (u64)0x0001 << 48,              // DrDe, DgDe, DbDe, DaDe
+        (u64)0x0001 << 48,              // DrDy, DgDy, DbDy, DaDy
+        0,
+        0,
+    };
+    static u16 unclipped[HEIGHT][WIDTH];
+
+    set_cycle_type(CYCLE_TYPE_1CYCLE);
+    send_one((u64)0x3C << 56 | (u64)31 << 47 | (u64)7 << 41 | (u64)31 << 32 | (u64)7 << 18
+             | (u64)4 << 15 | (u64)6 << 9 | (u64)4 << 6 | 6); // Output the shade color
+
+    clear_color_image();
+    send_box_triangle(0x0C, false, -20, 100, -30, 60, shade);
+    softrdp_flush(&rdp);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            unclipped[y][x] = get_pixel(x, y);
+        }
+    }
+
+    clear_color_image();
+    set_scissor(0, 40, WIDTH, HEIGHT);
+    send_box_triangle(0x0C, false, -20, 100, -30, 60, shade);
+    softrdp_flush(&rdp);
+    set_scissor(0, 0, WIDTH, HEIGHT);
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            u16 expected = y < 40 ? BACKGROUND : unclipped[y][x];
+            if (get_pixel(x, y) != expected) {
+                printf(COLOR_RED "[FAILED] shade below scissor: pixel (%d, %d) is 0x%04X, expected 0x%04X\n" COLOR_END,
+                       x, y, get_pixel(x, y), expected);
+                return false;
+            }
+        }
+    }
+    // Red went up with Y, so the rows can't all be the same
+    if (get_pixel(0, 40) == get_pixel(0, 59)) {
+        printf(COLOR_RED "[FAILED] shade below scissor: shade doesn't change down the triangle\n" COLOR_END);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    softrdp_init(&rdp, rdram);
+
+    send_one((u64)0x3F << 56 | (u64)2 << 51 | (u64)(WIDTH - 1) << 32 | COLOR_IMAGE); // Set color image, 16bpp
+    send_one((u64)0x37 << 56 | 0xF801F801);                                          // Set fill color
+    send_one((u64)0x3A << 56 | 0xFF0000FF);                                          // Set prim color, red
+    send_one((u64)0x3C << 56 | (u64)31 << 47 | (u64)7 << 41 | (u64)31 << 32 | (u64)7 << 18
+             | (u64)3 << 15 | (u64)6 << 9 | (u64)3 << 6 | 6);                         // Output the prim color
+
+    bool passed = true;
+    for (int cycle_type = CYCLE_TYPE_1CYCLE; cycle_type <= CYCLE_TYPE_FILL; cycle_type += CYCLE_TYPE_FILL) {
+        passed &= test_box("left edge, left major", cycle_type, false, -10, 50, 10, 20);
+        passed &= test_box("left edge, right major", cycle_type, true, -10, 50, 10, 20);
+        passed &= test_box("top edge", cycle_type, false, 20, 60, -5, 5);
+        passed &= test_box("top left corner", cycle_type, true, -300, 8, -2000, 3);
+        passed &= test_box("taller than a span list", cycle_type, false, 100, 110, -2000, 2000);
+    }
+    passed &= test_shade_below_scissor();
+
+    if (!passed) {
+        logfatal("Tests failed!");
+    }
+    printf("Passed!\n");
+}